@@ -1,52 +1,220 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <deque>
 #include <filesystem>
+#include <format>
 #include <fstream>
 #include <functional>
 #include <future>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <ranges>
+#include <string>
+#include <thread>
 #include <variant>
+#include <vector>
 
 #include "CLI11.hpp"
 
 import qct;
 import qctexport;
+import qctserve;
 
-void exports(const qct::QctFile& qct_file, const qct::ex::GeoTiffExportOptions& geotiff_export_options,
-             const qct::ex::KmlExportOptions& kml_export_options, const qct::ex::PngExportOptions& png_export_options);
+enum class ExportFormat { KML, GEOTIFF, PNG, XYZ, MBTILES, PMTILES };
+
+/**
+ * A QCT-file of a batch conversion.
+ */
+struct BatchInput final {
+  std::filesystem::path qct_file_path{};
+  /**
+   * The path of the exports relative to the output directory, without file extension.
+   */
+  std::filesystem::path export_path_stem{};
+};
+
+/**
+ * Options applied to every QCT-file of a batch conversion.
+ */
+struct BatchOptions final {
+  std::filesystem::path output_dir{};
+  std::vector<ExportFormat> export_formats{};
+  qct::ex::GeoTiffExportOptions::GeorefMethod geotiff_georef_method{};
+  std::optional<std::int32_t> min_zoom{};
+  std::optional<std::int32_t> max_zoom{};
+  std::size_t memory_budget_byte_count{0};
+  bool force_decode{false};
+  qct::image::DecodeOptions decode_options{};
+};
+
+void exports(const std::shared_ptr<const qct::QctFile>& qct_file,
+             const qct::ex::GeoTiffExportOptions& geotiff_export_options,
+             const qct::ex::KmlExportOptions& kml_export_options, const qct::ex::PngExportOptions& png_export_options,
+             const qct::ex::XyzExportOptions& xyz_export_options,
+             const qct::ex::MbTilesExportOptions& mbtiles_export_options,
+             const qct::ex::PmTilesExportOptions& pmtiles_export_options);
+
+std::vector<BatchInput> collectBatchInputs(const std::vector<std::filesystem::path>& paths, bool recursive);
+
+std::int32_t convertBatch(const std::vector<BatchInput>& batch_inputs, const BatchOptions& options,
+                          qct::util::ThreadPool& thread_pool);
+
+std::int32_t serve(const std::vector<BatchInput>& batch_inputs, const qct::serve::ServeOptions& options,
+                   std::size_t max_open_map_count, bool force_decode, const qct::image::DecodeOptions& decode_options,
+                   std::int32_t thread_count);
 
 int main(const int argc, char** argv) {
   CLI::App app{"QCT Convert"};
   argv = app.ensure_utf8(argv);
 
   bool force_decode{false};
-  std::filesystem::path qct_file_path{};
+  bool recursive{false};
+  std::int32_t thread_count{0};
+  std::size_t memory_budget_mib{0};
+  std::vector<std::filesystem::path> qct_file_paths{};
   std::filesystem::path kml_export_path{};
   std::filesystem::path geotiff_export_path{};
   std::filesystem::path png_export_path{};
+  std::filesystem::path xyz_export_path{};
+  std::filesystem::path mbtiles_export_path{};
+  std::filesystem::path pmtiles_export_path{};
+  std::optional<std::int32_t> min_zoom{};
+  std::optional<std::int32_t> max_zoom{};
+  std::filesystem::path output_dir{"."};
+  std::vector<ExportFormat> export_formats{};
   auto geotiff_georef_method{qct::ex::GeoTiffExportOptions::GeorefMethod::AUTOMATIC};
   std::map<std::string, qct::ex::GeoTiffExportOptions::GeorefMethod> georef_method_mapper{
       {"auto", qct::ex::GeoTiffExportOptions::GeorefMethod::AUTOMATIC},
       {"gcp", qct::ex::GeoTiffExportOptions::GeorefMethod::GCP},
       {"linear", qct::ex::GeoTiffExportOptions::GeorefMethod::LINEAR}};
+  qct::image::DecodeOptions decode_options{.pixel_format = qct::image::PixelFormat::INDEXED};
+  std::map<std::string, qct::image::DecodeOptions::Order> decode_order_mapper{
+      {"row", qct::image::DecodeOptions::Order::ROW_MAJOR}, {"offset", qct::image::DecodeOptions::Order::FILE_OFFSET}};
+  std::map<std::string, qct::image::PixelFormat> pixel_format_mapper{{"indexed", qct::image::PixelFormat::INDEXED},
+                                                                     {"rgb", qct::image::PixelFormat::RGB}};
+  std::map<std::string, ExportFormat> export_format_mapper{{"kml", ExportFormat::KML},
+                                                           {"geotiff", ExportFormat::GEOTIFF},
+                                                           {"png", ExportFormat::PNG},
+                                                           {"xyz", ExportFormat::XYZ},
+                                                           {"mbtiles", ExportFormat::MBTILES},
+                                                           {"pmtiles", ExportFormat::PMTILES}};
 
-  app.add_option("qct-file-path", qct_file_path, "Path to the .qct file")->required();
+  app.add_option("qct-file-paths", qct_file_paths, "Paths to .qct files, or directories containing .qct files");
   app.add_flag("-f, --force", force_decode, "Force try to decode the .qct file, even if metadata is invalid");
+  app.add_flag("-r, --recursive", recursive, "Search directories for .qct files recursively");
+  app.add_option("--threads", thread_count, "Number of decoding threads, defaults to the hardware concurrency")
+      ->check(CLI::NonNegativeNumber);
+  app.add_option("--decode-order", decode_options.order, "Order in which the image tiles are decoded")
+      ->transform(CLI::CheckedTransformer(decode_order_mapper, CLI::ignore_case));
+  app.add_option("--pixel-format", decode_options.pixel_format, "In-memory pixel format of the decoded image")
+      ->transform(CLI::CheckedTransformer(pixel_format_mapper, CLI::ignore_case));
   app.add_option("--export-kml-path", kml_export_path, "Path to optional .kml export");
   app.add_option("--export-geotiff-path", geotiff_export_path, "Path to optional GeoTIFF (.tiff) export");
   app.add_option("--export-png-path", png_export_path, "Path to optional .png export");
+  app.add_option("--export-xyz-path", xyz_export_path, "Path to optional directory of XYZ tiles ({z}/{x}/{y}.png)");
+  app.add_option("--export-mbtiles-path", mbtiles_export_path, "Path to optional .mbtiles export of the XYZ tiles");
+  app.add_option("--export-pmtiles-path", pmtiles_export_path, "Path to optional .pmtiles export of the XYZ tiles");
+  app.add_option("--min-zoom", min_zoom, "Lowest zoom level of tile exports, defaults to the whole map in a tile")
+      ->check(CLI::Range(0, qct::tiles::WebMercatorRenderer::MAX_ZOOM));
+  app.add_option("--max-zoom", max_zoom, "Highest zoom level of tile exports, defaults to the map resolution")
+      ->check(CLI::Range(0, qct::tiles::WebMercatorRenderer::MAX_ZOOM));
   app.add_option("--geotiff-georef-method", geotiff_georef_method, "Georeferencing method for GeoTIFF export")
       ->transform(CLI::CheckedTransformer(georef_method_mapper, CLI::ignore_case));
+  app.add_option("--export", export_formats, "Formats to export every .qct file to (batch mode)")
+      ->transform(CLI::CheckedTransformer(export_format_mapper, CLI::ignore_case));
+  app.add_option("--output-dir", output_dir, "Directory to write the exports to (batch mode)");
+  app.add_option("--memory-budget", memory_budget_mib, "Approximate memory limit in MiB for exports (batch mode)")
+      ->check(CLI::NonNegativeNumber);
+
+  std::vector<std::filesystem::path> map_paths{};
+  qct::serve::ServeOptions serve_options{};
+  std::size_t max_open_map_count{16};
+  std::size_t tile_cache_mib{decode_options.tile_cache_byte_count >> 20};
+  CLI::App* serve_command = app.add_subcommand("serve", "Serve the maps as PNG tiles at /{map}/{z}/{x}/{y}.png");
+  serve_command->fallthrough();
+  serve_command->add_option("map-paths", map_paths, "Paths to .qct files, or directories containing .qct files")
+      ->required();
+  serve_command->add_option("--host", serve_options.host, "Address to listen on")->capture_default_str();
+  serve_command->add_option("--port", serve_options.port, "TCP port to listen on")->capture_default_str();
+  serve_command->add_option("--unix-socket", serve_options.unix_socket_path,
+                            "Listen on this Unix domain socket instead of the TCP port");
+  serve_command->add_option("--max-open-maps", max_open_map_count, "Number of maps kept open")
+      ->check(CLI::PositiveNumber)
+      ->capture_default_str();
+  serve_command->add_option("--tile-cache", tile_cache_mib, "Decoded tiles cached per open map in MiB")
+      ->check(CLI::NonNegativeNumber)
+      ->capture_default_str();
   CLI11_PARSE(app, argc, argv)
 
+  if (*serve_command) {
+    decode_options.tile_cache_byte_count = tile_cache_mib << 20;
+    try {
+      return serve(collectBatchInputs(map_paths, recursive), serve_options, max_open_map_count, force_decode,
+                   decode_options, thread_count);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+  }
+  if (qct_file_paths.empty()) {
+    std::cerr << "qct-file-paths is required" << std::endl << app.help() << std::endl;
+    return 1;
+  }
+
+  const std::filesystem::path& qct_file_path = qct_file_paths.front();
+  if (!export_formats.empty() || qct_file_paths.size() > 1 || is_directory(qct_file_path)) {
+    if (!geotiff_export_path.empty() || !kml_export_path.empty() || !png_export_path.empty() ||
+        !xyz_export_path.empty() || !mbtiles_export_path.empty() || !pmtiles_export_path.empty()) {
+      std::cerr << "Export paths only apply to a single .qct file, use --export and --output-dir instead" << std::endl;
+      return 1;
+    }
+    try {
+      const std::vector<BatchInput> batch_inputs = collectBatchInputs(qct_file_paths, recursive);
+      qct::util::ThreadPool thread_pool{thread_count};
+      const std::int32_t failure_count = convertBatch(batch_inputs,
+                                                      {.output_dir = output_dir,
+                                                       .export_formats = export_formats,
+                                                       .geotiff_georef_method = geotiff_georef_method,
+                                                       .min_zoom = min_zoom,
+                                                       .max_zoom = max_zoom,
+                                                       .memory_budget_byte_count = memory_budget_mib << 20,
+                                                       .force_decode = force_decode,
+                                                       .decode_options = decode_options},
+                                                      thread_pool);
+      std::cout << "Converted " << batch_inputs.size() - failure_count << " of " << batch_inputs.size() << " files"
+                << std::endl;
+      return failure_count == 0 ? 0 : 1;
+    } catch (const std::filesystem::filesystem_error& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+  }
+
   if (exists(qct_file_path)) {
     if (is_regular_file(qct_file_path)) {
       std::ifstream file{qct_file_path, std::ios::binary};
       try {
-        const qct::QctFile qct_file = qct::QctFile::parse(qct_file_path, force_decode);
+        if (geotiff_export_path.empty() && kml_export_path.empty() && png_export_path.empty() &&
+            xyz_export_path.empty() && mbtiles_export_path.empty() && pmtiles_export_path.empty()) {
+          // Nothing to export, the tile data is never read
+          std::cout << qct::QctFile::parseHeader(qct_file_path, force_decode).metadata << std::endl;
+          return 0;
+        }
+        qct::util::ThreadPool thread_pool{thread_count};
+        const auto qct_file = std::make_shared<const qct::QctFile>(
+            qct::QctFile::parse(qct_file_path, thread_pool, force_decode, decode_options));
+        std::cout << qct_file->metadata << std::endl;
         qct::ex::GeoTiffExportOptions geotiff_export_options{geotiff_export_path, geotiff_georef_method};
         qct::ex::KmlExportOptions kml_export_options{kml_export_path};
         qct::ex::PngExportOptions png_export_options{png_export_path};
-        exports(qct_file, geotiff_export_options, kml_export_options, png_export_options);
+        qct::ex::XyzExportOptions xyz_export_options{xyz_export_path, thread_pool, min_zoom, max_zoom};
+        qct::ex::MbTilesExportOptions mbtiles_export_options{mbtiles_export_path, thread_pool, min_zoom, max_zoom};
+        qct::ex::PmTilesExportOptions pmtiles_export_options{pmtiles_export_path, thread_pool, min_zoom, max_zoom};
+        exports(qct_file, geotiff_export_options, kml_export_options, png_export_options, xyz_export_options,
+                mbtiles_export_options, pmtiles_export_options);
       } catch (const qct::QctException& e) {
         std::cerr << e.what() << std::endl;
       }
@@ -58,20 +226,282 @@ int main(const int argc, char** argv) {
   }
 }
 
-void exports(const qct::QctFile& qct_file, const qct::ex::GeoTiffExportOptions& geotiff_export_options,
-             const qct::ex::KmlExportOptions& kml_export_options, const qct::ex::PngExportOptions& png_export_options) {
+template <typename O>
+std::future<void> exportAsync(const std::shared_ptr<const qct::QctFile>& qct_file, const O& export_options) {
+  // The task shares ownership of the decoded file instead of copying it
+  return std::async(std::launch::async, [qct_file, export_options] {
+    static_cast<void>(qct::ex::exportToFormat<O>(*qct_file, export_options));
+  });
+}
+
+void exports(const std::shared_ptr<const qct::QctFile>& qct_file,
+             const qct::ex::GeoTiffExportOptions& geotiff_export_options,
+             const qct::ex::KmlExportOptions& kml_export_options, const qct::ex::PngExportOptions& png_export_options,
+             const qct::ex::XyzExportOptions& xyz_export_options,
+             const qct::ex::MbTilesExportOptions& mbtiles_export_options,
+             const qct::ex::PmTilesExportOptions& pmtiles_export_options) {
   std::vector<std::future<void>> export_futures{};
-  if (!geotiff_export_options.path.empty()) {
-    export_futures.push_back(std::async(std::launch::async, qct::ex::exportToFormat<qct::ex::GeoTiffExportOptions>,
-                                        qct_file, geotiff_export_options));
+  if (!geotiff_export_options.path.empty() || !png_export_options.path.empty()) {
+    // The raster exports are fed from a single decode of the image
+    export_futures.push_back(std::async(std::launch::async, [qct_file, geotiff_export_options, png_export_options] {
+      static_cast<void>(qct::ex::exportToRasterFormats(*qct_file, geotiff_export_options, png_export_options));
+    }));
   }
   if (!kml_export_options.path.empty()) {
-    export_futures.push_back(std::async(std::launch::async, qct::ex::exportToFormat<qct::ex::KmlExportOptions>,
-                                        qct_file, kml_export_options));
+    export_futures.push_back(exportAsync(qct_file, kml_export_options));
+  }
+  if (!xyz_export_options.path.empty()) {
+    export_futures.push_back(exportAsync(qct_file, xyz_export_options));
   }
-  if (!png_export_options.path.empty()) {
-    export_futures.push_back(std::async(std::launch::async, qct::ex::exportToFormat<qct::ex::PngExportOptions>,
-                                        qct_file, png_export_options));
+  if (!mbtiles_export_options.path.empty()) {
+    export_futures.push_back(exportAsync(qct_file, mbtiles_export_options));
+  }
+  if (!pmtiles_export_options.path.empty()) {
+    export_futures.push_back(exportAsync(qct_file, pmtiles_export_options));
   }
   std::ranges::for_each(export_futures, [](auto& future) { future.wait(); });
 }
+
+std::vector<BatchInput> collectBatchInputs(const std::vector<std::filesystem::path>& paths, const bool recursive) {
+  const auto is_qct_file = [](const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::ranges::transform(extension, extension.begin(), [](const unsigned char c) { return std::tolower(c); });
+    return extension == ".qct";
+  };
+  std::vector<BatchInput> batch_inputs{};
+  for (const std::filesystem::path& path : paths) {
+    if (is_directory(path)) {
+      std::vector<std::filesystem::path> qct_file_paths{};
+      const auto collect = [&](auto directory_iterator) {
+        for (const std::filesystem::directory_entry& entry : directory_iterator) {
+          if (entry.is_regular_file() && is_qct_file(entry.path())) {
+            qct_file_paths.push_back(entry.path());
+          }
+        }
+      };
+      recursive ? collect(std::filesystem::recursive_directory_iterator{path})
+                : collect(std::filesystem::directory_iterator{path});
+      std::ranges::sort(qct_file_paths);
+      for (const std::filesystem::path& qct_file_path : qct_file_paths) {
+        batch_inputs.push_back({.qct_file_path = qct_file_path,
+                                .export_path_stem = relative(qct_file_path, path).replace_extension()});
+      }
+    } else if (is_regular_file(path)) {
+      batch_inputs.push_back({.qct_file_path = path, .export_path_stem = path.filename().replace_extension()});
+    } else {
+      std::cerr << "File does not exist:  " << path << std::endl;
+    }
+  }
+  return batch_inputs;
+}
+
+/**
+ * Estimate the peak memory of exporting a QCT-file: the band window of the streamed image, plus the largest buffer
+ * of any of the exports, as the exports of a file run one after another.
+ */
+std::size_t estimateExportByteCount(const qct::QctFile& qct_file, const BatchOptions& options) {
+  const auto width = static_cast<std::size_t>(qct_file.width());
+  const std::size_t band_byte_count =
+      width * qct::image::ImageTile::HEIGHT * qct::image::bytesPerPixel(options.decode_options.pixel_format);
+  // The raster exports are fed from the same decode, so their buffers add up
+  std::size_t raster_export_byte_count{0};
+  const std::size_t pyramid_byte_count = options.decode_options.tile_cache_byte_count +
+                                         qct::ex::PYRAMID_BLOCKS_IN_FLIGHT * qct::ex::PYRAMID_BLOCK_BYTE_COUNT;
+  std::size_t export_byte_count{0};
+  for (const ExportFormat export_format : options.export_formats) {
+    switch (export_format) {
+      case ExportFormat::KML:
+        break;
+      case ExportFormat::GEOTIFF:
+        raster_export_byte_count += width * qct::image::ImageTile::HEIGHT * 3;
+        break;
+      case ExportFormat::PNG:
+        raster_export_byte_count += width * qct_file.height() * 3;
+        break;
+      case ExportFormat::XYZ:
+        // The tile cache of the file fills up, next to the pixels of the block of tiles being rendered
+        export_byte_count = std::max(export_byte_count, pyramid_byte_count);
+        break;
+      case ExportFormat::MBTILES:
+        // Plus the encoded tiles queued for the writer, at most a few dozen KiB each
+        export_byte_count = std::max(
+            export_byte_count, pyramid_byte_count + qct::ex::MbTilesExporter::MAX_QUEUED_TILE_COUNT * (32 << 10));
+        break;
+      case ExportFormat::PMTILES:
+        // Plus the encoded tiles queued for the writer, the directory entries are small
+        export_byte_count = std::max(
+            export_byte_count, pyramid_byte_count + qct::ex::PmTilesExporter::MAX_QUEUED_TILE_COUNT * (32 << 10));
+        break;
+    }
+  }
+  return band_byte_count * std::max(1, options.decode_options.max_bands_in_flight) +
+         std::max(raster_export_byte_count, export_byte_count);
+}
+
+/**
+ * Export a QCT-file of a batch to all formats.
+ * @return whether all exports succeeded
+ */
+bool exportBatchFile(const qct::QctFile& qct_file, const BatchInput& batch_input, const BatchOptions& options,
+                     qct::util::ThreadPool& thread_pool) {
+  const std::filesystem::path export_path_stem = options.output_dir / batch_input.export_path_stem;
+  std::error_code error_code{};
+  create_directories(export_path_stem.parent_path(), error_code);
+  if (error_code) {
+    std::cerr << "Failed to create " << export_path_stem.parent_path() << ": " << error_code.message() << std::endl;
+    return false;
+  }
+  const auto export_path = [&](const std::string& extension) {
+    return std::filesystem::path{export_path_stem} += extension;
+  };
+  const auto exports_to = [&](const ExportFormat export_format) {
+    return std::ranges::find(options.export_formats, export_format) != options.export_formats.end();
+  };
+  bool succeeded{true};
+  if (exports_to(ExportFormat::GEOTIFF) || exports_to(ExportFormat::PNG)) {
+    // The raster exports are fed from a single decode of the image, an empty path skips a format
+    const std::filesystem::path geotiff_path = exports_to(ExportFormat::GEOTIFF) ? export_path(".tiff") : "";
+    const std::filesystem::path png_path = exports_to(ExportFormat::PNG) ? export_path(".png") : "";
+    succeeded &= qct::ex::exportToRasterFormats(
+        qct_file, qct::ex::GeoTiffExportOptions{geotiff_path, options.geotiff_georef_method},
+        qct::ex::PngExportOptions{png_path});
+  }
+  for (const ExportFormat export_format : options.export_formats) {
+    switch (export_format) {
+      case ExportFormat::KML:
+        succeeded &= qct::ex::exportToFormat(qct_file, qct::ex::KmlExportOptions{export_path(".kml")});
+        break;
+      case ExportFormat::GEOTIFF:
+      case ExportFormat::PNG:
+        // Exported above
+        break;
+      case ExportFormat::XYZ:
+        succeeded &= qct::ex::exportToFormat(
+            qct_file, qct::ex::XyzExportOptions{export_path_stem, thread_pool, options.min_zoom, options.max_zoom});
+        break;
+      case ExportFormat::MBTILES:
+        succeeded &= qct::ex::exportToFormat(
+            qct_file, qct::ex::MbTilesExportOptions{export_path(".mbtiles"), thread_pool, options.min_zoom,
+                                                    options.max_zoom});
+        break;
+      case ExportFormat::PMTILES:
+        succeeded &= qct::ex::exportToFormat(
+            qct_file, qct::ex::PmTilesExportOptions{export_path(".pmtiles"), thread_pool, options.min_zoom,
+                                                    options.max_zoom});
+        break;
+    }
+  }
+  return succeeded;
+}
+
+std::int32_t convertBatch(const std::vector<BatchInput>& batch_inputs, const BatchOptions& options,
+                          qct::util::ThreadPool& thread_pool) {
+  // Headers are parsed on the pool a few files ahead. As soon as the memory budget admits the next file, its export
+  // is handed to one of a few dedicated driver threads, which queue only the band and tile work of the file on the
+  // pool. The drivers are no pool tasks, so a worker waiting for tiles never picks up the export of another file.
+  const auto header_lookahead = static_cast<std::size_t>(thread_pool.threadCount()) * 2;
+  const std::int32_t driver_count = std::clamp(thread_pool.threadCount() / 4, 2, 8);
+  qct::util::MemoryBudget memory_budget{options.memory_budget_byte_count};
+  std::mutex output_mutex{};
+  std::atomic<std::int32_t> failure_count{0};
+  struct ExportJob {
+    qct::QctFile qct_file;
+    const BatchInput* batch_input;
+    qct::util::MemoryBudget::Reservation reservation;
+  };
+  qct::util::BoundedQueue<ExportJob> export_jobs{1};
+  std::vector<std::thread> drivers{};
+  for (std::int32_t driver_index = 0; driver_index < driver_count; ++driver_index) {
+    drivers.emplace_back([&] {
+      // The job, and with it the file and its reservation, is released before the next one is taken
+      while (const std::optional<ExportJob> export_job = export_jobs.pop()) {
+        const BatchInput& batch_input = *export_job->batch_input;
+        bool succeeded{false};
+        try {
+          succeeded = exportBatchFile(export_job->qct_file, batch_input, options, thread_pool);
+        } catch (const std::exception& e) {
+          std::lock_guard lock{output_mutex};
+          std::cerr << batch_input.qct_file_path << ": " << e.what() << std::endl;
+        }
+        std::lock_guard lock{output_mutex};
+        if (succeeded) {
+          std::cout << "Converted " << batch_input.qct_file_path << std::endl;
+        } else {
+          std::cerr << "Failed to convert " << batch_input.qct_file_path << std::endl;
+          ++failure_count;
+        }
+      }
+    });
+  }
+  std::exception_ptr exception{};
+  try {
+    std::deque<std::future<qct::QctFile>> header_futures{};
+    std::size_t next_header_index{0};
+    for (const BatchInput& batch_input : batch_inputs) {
+      for (; next_header_index < batch_inputs.size() && header_futures.size() < header_lookahead;
+           ++next_header_index) {
+        header_futures.push_back(
+            thread_pool.submit([&, &qct_file_path = batch_inputs[next_header_index].qct_file_path] {
+              return options.export_formats.empty()
+                         ? qct::QctFile::parseHeader(qct_file_path, options.force_decode)
+                         : qct::QctFile::parse(qct_file_path, thread_pool, options.force_decode,
+                                               options.decode_options);
+            }));
+      }
+      std::future<qct::QctFile> header_future = std::move(header_futures.front());
+      header_futures.pop_front();
+      qct::QctFile qct_file{};
+      try {
+        qct_file = header_future.get();
+      } catch (const std::exception& e) {
+        std::lock_guard lock{output_mutex};
+        std::cerr << batch_input.qct_file_path << ": " << e.what() << std::endl;
+        ++failure_count;
+        continue;
+      }
+      if (options.export_formats.empty()) {
+        std::lock_guard lock{output_mutex};
+        std::cout << batch_input.qct_file_path << "\n" << qct_file.metadata << std::endl;
+        continue;
+      }
+      qct::util::MemoryBudget::Reservation reservation =
+          memory_budget.reserve(estimateExportByteCount(qct_file, options));
+      export_jobs.push({.qct_file = std::move(qct_file),
+                        .batch_input = &batch_input,
+                        .reservation = std::move(reservation)});
+    }
+  } catch (...) {
+    exception = std::current_exception();
+  }
+  // The drivers finish the queued jobs and stop
+  export_jobs.close();
+  std::ranges::for_each(drivers, [](std::thread& driver) { driver.join(); });
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+  return failure_count;
+}
+
+std::int32_t serve(const std::vector<BatchInput>& batch_inputs, const qct::serve::ServeOptions& options,
+                   const std::size_t max_open_map_count, const bool force_decode,
+                   const qct::image::DecodeOptions& decode_options, const std::int32_t thread_count) {
+  std::vector<qct::serve::MapSource> map_sources{};
+  for (const BatchInput& batch_input : batch_inputs) {
+    map_sources.push_back(
+        {.name = batch_input.export_path_stem.generic_string(), .qct_file_path = batch_input.qct_file_path});
+  }
+  if (map_sources.empty()) {
+    std::cerr << "No .qct files to serve" << std::endl;
+    return 1;
+  }
+  qct::util::ThreadPool thread_pool{thread_count};
+  qct::serve::MapRegistry map_registry{std::move(map_sources), thread_pool, max_open_map_count, force_decode,
+                                       decode_options};
+  qct::serve::TileServer tile_server{map_registry, thread_pool, options};
+  std::cout << "Serving " << map_registry.mapSources().size() << " maps on "
+            << (options.unix_socket_path.empty() ? std::format("http://{}:{}", options.host, tile_server.port())
+                                                 : options.unix_socket_path.string())
+            << std::endl;
+  tile_server.run();
+  return 0;
+}
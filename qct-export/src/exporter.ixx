@@ -43,4 +43,38 @@ class AbstractExporter {
   [[nodiscard]] C& underlying() { return static_cast<C&>(*this); }
   [[nodiscard]] const C& underlying() const { return static_cast<const C&>(*this); }
 };
+
+/**
+ * An export in progress consuming the image band by band, top to bottom, so that several exports are fed from a single
+ * decode of the image.
+ */
+class BandExport {
+ public:
+  virtual ~BandExport() = default;
+
+  /**
+   * Write the next band of the image.
+   * @param band the band
+   * @throws QctExportException if the band cannot be written
+   */
+  virtual void write(const image::ImageBand& band) = 0;
+
+  /**
+   * Complete the export after the last band.
+   * @throws QctExportException if the export cannot be completed
+   */
+  virtual void finish() = 0;
+};
+
+/**
+ * Feed the image of a QCT file to a single band export, and complete it.
+ * @param qct_file the QCT file
+ * @param band_export the export
+ * @throws QctException if the image cannot be decoded
+ * @throws QctExportException if the export fails
+ */
+void exportBands(const QctFile& qct_file, BandExport& band_export) {
+  qct_file.forEachImageBand([&](const image::ImageBand& band) { band_export.write(band); });
+  band_export.finish();
+}
 }  // namespace qct::ex
@@ -5,7 +5,9 @@ module;
 #include <filesystem>
 #include <format>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <span>
 #include <stdexcept>
 #include <vector>
 
@@ -70,7 +72,21 @@ class GeoTiffExporter final : public AbstractExporter<GeoTiffExporter, GeoTiffEx
    */
   void exportTo(const QctFile& qct_file, const GeoTiffExportOptions& options) const;
 
+  /**
+   * Start exporting the given QCT file as a GeoTIFF file, to be fed with the bands of the image.
+   * The file is created and georeferenced right away.
+   *
+   * @param qct_file The QCT file to export, must outlive the export.
+   * @param options The export options for the GeoTIFF file.
+   * @return the export in progress
+   * @throws QctExportException if the file cannot be created
+   */
+  [[nodiscard]] std::unique_ptr<BandExport> startBandExport(const QctFile& qct_file,
+                                                            const GeoTiffExportOptions& options) const;
+
  private:
+  class GeoTiffBandExport;
+
   static constexpr std::int32_t EPSG_4326_WGS84{4326};
   static std::once_flag once_flag_;
 
@@ -96,11 +112,50 @@ class GeoTiffExporter final : public AbstractExporter<GeoTiffExporter, GeoTiffEx
   static void setProjection(GDALDataset& gdal_dataset);
 
   /**
-   * Write the raster bands of a QCT file to a GeoTIFF file.
-   * @param qct_file the QCT file
-   * @param gdal_dataset the GDAL dataset to write the raster bands to
+   * Write pixel-interleaved RGB rows to all three raster bands at once.
+   * @param gdal_dataset the GDAL dataset to write the rows to
+   * @param y the first row to write
+   * @param row_count the amount of rows to write
+   * @param width the width of the rows in pixels
+   * @param rgb_bytes the RGB bytes of the rows
    */
-  static void writeRasterBands(const QctFile& qct_file, GDALDataset& gdal_dataset);
+  static void writeRgbRows(GDALDataset& gdal_dataset, std::int32_t y, std::int32_t row_count, std::int32_t width,
+                           const std::uint8_t* rgb_bytes);
+};
+
+/**
+ * Writes the raster bands of a GeoTIFF file one image band at a time, as it is decoded. RGB bands are written straight
+ * from the pixel-interleaved band bytes, indexed bands are expanded first.
+ */
+class GeoTiffExporter::GeoTiffBandExport final : public BandExport {
+ public:
+  GeoTiffBandExport(const QctFile& qct_file, GDALDataset* gdal_dataset)
+      : qct_file_{qct_file}, gdal_dataset_{gdal_dataset} {}
+
+  void write(const image::ImageBand& band) override {
+    const std::int32_t width = qct_file_.width();
+    if (band.pixel_format == image::PixelFormat::RGB) {
+      writeRgbRows(*gdal_dataset_, band.y, band.row_count, width, band.bytes.data());
+      return;
+    }
+    rgb_band_bytes_.resize(static_cast<std::size_t>(band.row_count) * width * palette::COLOR_CHANNELS);
+    band.expandRgb(qct_file_.palette, rgb_band_bytes_);
+    writeRgbRows(*gdal_dataset_, band.y, band.row_count, width, rgb_band_bytes_.data());
+  }
+
+  void finish() override {
+    // Closing the dataset flushes it to the file
+    GDALClose(gdal_dataset_.release());
+  }
+
+ private:
+  struct GdalDatasetCloser final {
+    void operator()(GDALDataset* gdal_dataset) const { GDALClose(gdal_dataset); }
+  };
+
+  const QctFile& qct_file_;
+  std::unique_ptr<GDALDataset, GdalDatasetCloser> gdal_dataset_;
+  std::vector<std::uint8_t> rgb_band_bytes_{};
 };
 
 std::once_flag GeoTiffExporter::once_flag_{};
@@ -110,6 +165,11 @@ GeoTiffExporter::GeoTiffExporter() {
 }
 
 void GeoTiffExporter::exportTo(const QctFile& qct_file, const GeoTiffExportOptions& options) const {
+  exportBands(qct_file, *startBandExport(qct_file, options));
+}
+
+std::unique_ptr<BandExport> GeoTiffExporter::startBandExport(const QctFile& qct_file,
+                                                             const GeoTiffExportOptions& options) const {
   constexpr auto driver_name{"GTiff"};
   GDALAllRegister();
   GDALDriver* gdal_driver = GetGDALDriverManager()->GetDriverByName(driver_name);
@@ -121,6 +181,8 @@ void GeoTiffExporter::exportTo(const QctFile& qct_file, const GeoTiffExportOptio
   if (gdal_dataset == nullptr) {
     throw QctExportException{"Failed to create GDAL-dataset"};
   }
+  // Closes the dataset, should georeferencing fail
+  auto band_export = std::make_unique<GeoTiffBandExport>(qct_file, gdal_dataset);
   switch (options.georef_method) {
     case GeoTiffExportOptions::GeorefMethod::AUTOMATIC: {
       if (qct_file.georef.coefficients.anyNonZeroLonLatSecondOrThirdOrderTerms()) {
@@ -143,8 +205,7 @@ void GeoTiffExporter::exportTo(const QctFile& qct_file, const GeoTiffExportOptio
       throw std::logic_error{"Unknown GeoTiffExportOptions::GeorefMethod"};
   }
   setProjection(*gdal_dataset);
-  writeRasterBands(qct_file, *gdal_dataset);
-  GDALClose(gdal_dataset);
+  return band_export;
 }
 
 void GeoTiffExporter::setProjContextSearchPaths() {
@@ -198,14 +259,17 @@ void GeoTiffExporter::setProjection(GDALDataset& gdal_dataset) {
   gdal_dataset.SetProjection(spatial_reference.exportToWkt().c_str());
 }
 
-void GeoTiffExporter::writeRasterBands(const QctFile& qct_file, GDALDataset& gdal_dataset) {
-  for (std::int32_t channel_index = 0; channel_index < palette::COLOR_CHANNELS; ++channel_index) {
-    auto band_bytes = qct_file.image_index.channelBytes(channel_index);
-    if (GDALRasterBand* gdal_raster_band = gdal_dataset.GetRasterBand(channel_index + 1);
-        gdal_raster_band->RasterIO(GF_Write, 0, 0, qct_file.width(), qct_file.height(), band_bytes.data(),
-                                   qct_file.width(), qct_file.height(), GDT_Byte, 0, 0) != CE_None) {
-      throw QctExportException{"Error writing raster data."};
-    }
+void GeoTiffExporter::writeRgbRows(GDALDataset& gdal_dataset, const std::int32_t y, const std::int32_t row_count,
+                                   const std::int32_t width, const std::uint8_t* rgb_bytes) {
+  constexpr std::array<int, palette::COLOR_CHANNELS> band_map{1, 2, 3};
+  constexpr GSpacing pixel_space{palette::COLOR_CHANNELS};
+  const GSpacing line_space{pixel_space * width};
+  constexpr GSpacing band_space{1};
+  // GDAL only reads from the buffer when writing
+  if (gdal_dataset.RasterIO(GF_Write, 0, y, width, row_count, const_cast<std::uint8_t*>(rgb_bytes), width, row_count,
+                            GDT_Byte, palette::COLOR_CHANNELS, band_map.data(), pixel_space, line_space, band_space,
+                            nullptr) != CE_None) {
+    throw QctExportException{"Error writing raster data."};
   }
 }
 
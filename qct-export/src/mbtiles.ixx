@@ -0,0 +1,292 @@
+module;
+
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sqlite3.h>
+
+export module qctexport:mbtiles;
+
+import qct;
+
+import :exception;
+import :exporter;
+import :pyramid;
+
+namespace qct::ex {
+/**
+ * An open SQLite database, closed on destruction.
+ */
+class SqliteDatabase final {
+ public:
+  /**
+   * Create a new database, or open an existing one.
+   * @param path of the database
+   * @throws QctExportException if the database cannot be opened
+   */
+  explicit SqliteDatabase(const std::filesystem::path& path);
+  ~SqliteDatabase();
+
+  SqliteDatabase(const SqliteDatabase&) = delete;
+  SqliteDatabase& operator=(const SqliteDatabase&) = delete;
+
+  [[nodiscard]] sqlite3* handle() const { return handle_; }
+
+  /**
+   * Execute SQL statements without results.
+   * @param sql the statements
+   * @throws QctExportException if a statement fails
+   */
+  void execute(const char* sql) const;
+
+  /**
+   * @param action that failed
+   * @return an exception describing the last error of the database
+   */
+  [[nodiscard]] QctExportException error(std::string_view action) const;
+
+ private:
+  sqlite3* handle_{nullptr};
+};
+
+/**
+ * A prepared SQLite statement, finalized on destruction.
+ */
+class SqliteStatement final {
+ public:
+  /**
+   * @param database to prepare the statement for, must outlive the statement
+   * @param sql the statement, with parameters numbered from 1
+   * @throws QctExportException if the statement cannot be prepared
+   */
+  SqliteStatement(const SqliteDatabase& database, const char* sql);
+  ~SqliteStatement();
+
+  SqliteStatement(const SqliteStatement&) = delete;
+  SqliteStatement& operator=(const SqliteStatement&) = delete;
+
+  void bind(std::int32_t index, std::int32_t value) const;
+  void bind(std::int32_t index, std::string_view value) const;
+  void bind(std::int32_t index, const std::vector<std::uint8_t>& value) const;
+
+  /**
+   * Execute the statement, then reset it to be executed again with new parameters.
+   * @throws QctExportException if the statement fails
+   */
+  void execute() const;
+
+ private:
+  const SqliteDatabase& database_;
+  sqlite3_stmt* handle_{nullptr};
+};
+
+/**
+ * Options for exporting a QCT file to an MBTiles file.
+ */
+export struct MbTilesExportOptions final : PyramidExportOptions {
+  /**
+   * @param path the MBTiles file
+   * @param thread_pool to render the tiles with
+   * @param min_zoom the lowest zoom level, or empty for the default
+   * @param max_zoom the highest zoom level, or empty for the native zoom level of the image
+   */
+  MbTilesExportOptions(const std::filesystem::path& path, util::ThreadPool& thread_pool,
+                       const std::optional<std::int32_t> min_zoom = std::nullopt,
+                       const std::optional<std::int32_t> max_zoom = std::nullopt)
+      : PyramidExportOptions{path, thread_pool, min_zoom, max_zoom} {}
+};
+
+/**
+ * Exporter for MBTiles files: a SQLite database holding a pyramid of PNG tiles in the Web Mercator projection.
+ * The tiles are rendered in parallel, and inserted by a single writer thread in large transactions.
+ */
+export class MbTilesExporter final : public AbstractExporter<MbTilesExporter, MbTilesExportOptions> {
+ public:
+  static constexpr std::size_t TILES_PER_TRANSACTION{4096};
+  static constexpr std::size_t MAX_QUEUED_TILE_COUNT{1024};
+
+  ~MbTilesExporter() override = default;
+
+  /**
+   * Export the given QCT file to the specified path as an MBTiles file, replacing an existing file.
+   *
+   * @param qct_file The QCT file to export.
+   * @param options The export options for the MBTiles export.
+   */
+  void exportTo(const QctFile& qct_file, const MbTilesExportOptions& options) const;
+
+ private:
+  struct Tile final {
+    tiles::TileCoordinates tile_coordinates{};
+    std::vector<std::uint8_t> png_bytes{};
+  };
+
+  static void writeMetadata(const SqliteDatabase& database, const QctFile& qct_file,
+                            const tiles::WebMercatorRenderer& renderer, const ZoomRange& zoom_range,
+                            const std::string& name);
+  static void writeTiles(const SqliteDatabase& database, util::BoundedQueue<Tile>& tile_queue);
+};
+
+SqliteDatabase::SqliteDatabase(const std::filesystem::path& path) {
+  const std::u8string utf8_path = path.u8string();
+  if (sqlite3_open_v2(reinterpret_cast<const char*>(utf8_path.c_str()), &handle_,
+                      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+    const QctExportException exception = error(std::format("Failed to open {}", path.string()));
+    sqlite3_close(handle_);
+    throw exception;
+  }
+}
+
+SqliteDatabase::~SqliteDatabase() {
+  sqlite3_close(handle_);
+}
+
+void SqliteDatabase::execute(const char* sql) const {
+  if (sqlite3_exec(handle_, sql, nullptr, nullptr, nullptr) != SQLITE_OK) {
+    throw error(std::format("Failed to execute {}", sql));
+  }
+}
+
+QctExportException SqliteDatabase::error(const std::string_view action) const {
+  return QctExportException{std::format("{}: {}", action, sqlite3_errmsg(handle_))};
+}
+
+SqliteStatement::SqliteStatement(const SqliteDatabase& database, const char* sql) : database_{database} {
+  if (sqlite3_prepare_v2(database_.handle(), sql, -1, &handle_, nullptr) != SQLITE_OK) {
+    throw database_.error(std::format("Failed to prepare {}", sql));
+  }
+}
+
+SqliteStatement::~SqliteStatement() {
+  sqlite3_finalize(handle_);
+}
+
+void SqliteStatement::bind(const std::int32_t index, const std::int32_t value) const {
+  sqlite3_bind_int(handle_, index, value);
+}
+
+void SqliteStatement::bind(const std::int32_t index, const std::string_view value) const {
+  sqlite3_bind_text(handle_, index, value.data(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
+}
+
+void SqliteStatement::bind(const std::int32_t index, const std::vector<std::uint8_t>& value) const {
+  // The blob is only read while executing, before the caller may release it
+  sqlite3_bind_blob(handle_, index, value.data(), static_cast<int>(value.size()), SQLITE_STATIC);
+}
+
+void SqliteStatement::execute() const {
+  const int result = sqlite3_step(handle_);
+  sqlite3_reset(handle_);
+  sqlite3_clear_bindings(handle_);
+  if (result != SQLITE_DONE) {
+    throw database_.error("Failed to execute statement");
+  }
+}
+
+void MbTilesExporter::exportTo(const QctFile& qct_file, const MbTilesExportOptions& options) const {
+  const tiles::WebMercatorRenderer renderer{qct_file};
+  const ZoomRange zoom_range = ZoomRange::resolve(renderer, qct_file, options.min_zoom, options.max_zoom);
+  std::error_code error_code{};
+  for (const char* suffix : {"", "-journal", "-wal", "-shm"}) {
+    remove(std::filesystem::path{options.path} += suffix, error_code);
+  }
+  const SqliteDatabase database{options.path};
+  // With a write-ahead log, committing a batch appends to the log without syncing the database
+  database.execute(
+      "PRAGMA journal_mode=WAL;"
+      "PRAGMA synchronous=NORMAL;"
+      "CREATE TABLE metadata (name TEXT, value TEXT);"
+      "CREATE TABLE tiles (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_data BLOB);"
+      "CREATE UNIQUE INDEX tile_index ON tiles (zoom_level, tile_column, tile_row);");
+  writeMetadata(database, qct_file, renderer, zoom_range, options.path.stem().string());
+
+  util::BoundedQueue<Tile> tile_queue{MAX_QUEUED_TILE_COUNT};
+  std::exception_ptr writer_exception{};
+  std::thread writer{[&] {
+    try {
+      writeTiles(database, tile_queue);
+    } catch (...) {
+      writer_exception = std::current_exception();
+    }
+    // Fails the renderers still pushing tiles
+    tile_queue.close();
+  }};
+  std::exception_ptr render_exception{};
+  try {
+    renderPyramid(qct_file, zoom_range, *options.thread_pool,
+                  [&](const tiles::TileCoordinates& tile_coordinates, std::vector<std::uint8_t> png_bytes) {
+                    if (!tile_queue.push({.tile_coordinates = tile_coordinates, .png_bytes = std::move(png_bytes)})) {
+                      throw QctExportException{"Failed to write tiles, the writer stopped"};
+                    }
+                  });
+  } catch (...) {
+    render_exception = std::current_exception();
+  }
+  tile_queue.close();
+  writer.join();
+  if (writer_exception) {
+    std::rethrow_exception(writer_exception);
+  }
+  if (render_exception) {
+    std::rethrow_exception(render_exception);
+  }
+  // Moves the write-ahead log into the database, leaving a single file
+  database.execute("PRAGMA journal_mode=DELETE;");
+}
+
+void MbTilesExporter::writeMetadata(const SqliteDatabase& database, const QctFile& qct_file,
+                                    const tiles::WebMercatorRenderer& renderer, const ZoomRange& zoom_range,
+                                    const std::string& name) {
+  const auto [min_longitude, min_latitude, max_longitude, max_latitude] = renderer.bounds();
+  const std::vector<std::pair<std::string, std::string>> metadata{
+      {"name", qct_file.metadata.name.empty() ? name : qct_file.metadata.name},
+      {"description", qct_file.metadata.long_title},
+      {"attribution", qct_file.metadata.copyright},
+      {"format", "png"},
+      {"type", "baselayer"},
+      {"version", "1"},
+      {"bounds", std::format("{},{},{},{}", min_longitude, min_latitude, max_longitude, max_latitude)},
+      {"center", std::format("{},{},{}", (min_longitude + max_longitude) / 2, (min_latitude + max_latitude) / 2,
+                             zoom_range.max_zoom)},
+      {"minzoom", std::to_string(zoom_range.min_zoom)},
+      {"maxzoom", std::to_string(zoom_range.max_zoom)}};
+  const SqliteStatement insert{database, "INSERT INTO metadata (name, value) VALUES (?1, ?2);"};
+  for (const auto& [key, value] : metadata) {
+    insert.bind(1, key);
+    insert.bind(2, value);
+    insert.execute();
+  }
+}
+
+void MbTilesExporter::writeTiles(const SqliteDatabase& database, util::BoundedQueue<Tile>& tile_queue) {
+  const SqliteStatement insert{database,
+                               "INSERT INTO tiles (zoom_level, tile_column, tile_row, tile_data) "
+                               "VALUES (?1, ?2, ?3, ?4);"};
+  std::size_t transaction_tile_count{0};
+  database.execute("BEGIN;");
+  while (const std::optional<Tile> tile = tile_queue.pop()) {
+    const auto [z, x, y] = tile->tile_coordinates;
+    insert.bind(1, z);
+    insert.bind(2, x);
+    // MBTiles numbers the rows from the bottom, like TMS
+    insert.bind(3, (1 << z) - 1 - y);
+    insert.bind(4, tile->png_bytes);
+    insert.execute();
+    if (++transaction_tile_count == TILES_PER_TRANSACTION) {
+      database.execute("COMMIT; BEGIN;");
+      transaction_tile_count = 0;
+    }
+  }
+  database.execute("COMMIT;");
+}
+
+}  // namespace qct::ex
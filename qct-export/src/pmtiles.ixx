@@ -0,0 +1,438 @@
+module;
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+export module qctexport:pmtiles;
+
+import qct;
+
+import :exception;
+import :exporter;
+import :pyramid;
+
+export namespace qct::ex {
+/**
+ * Options for exporting a QCT file to a PMTiles archive.
+ */
+struct PmTilesExportOptions final : PyramidExportOptions {
+  /**
+   * @param path the PMTiles archive
+   * @param thread_pool to render the tiles with
+   * @param min_zoom the lowest zoom level, or empty for the default
+   * @param max_zoom the highest zoom level, or empty for the native zoom level of the image
+   */
+  PmTilesExportOptions(const std::filesystem::path& path, util::ThreadPool& thread_pool,
+                       const std::optional<std::int32_t> min_zoom = std::nullopt,
+                       const std::optional<std::int32_t> max_zoom = std::nullopt)
+      : PyramidExportOptions{path, thread_pool, min_zoom, max_zoom} {}
+};
+
+/**
+ * Exporter for PMTiles archives (version 3): a single file holding a pyramid of PNG tiles in the Web Mercator
+ * projection, laid out for HTTP range requests. The tiles are rendered bottom-up in parallel, and spooled to a
+ * temporary file next to the archive by a single writer thread. Tiles with identical content, like open sea, are
+ * stored once. At the end, the tile data is copied into the archive in the order of the tile IDs, followed by the
+ * directories, and the header is written last, in front of the tile data.
+ */
+class PmTilesExporter final : public AbstractExporter<PmTilesExporter, PmTilesExportOptions> {
+ public:
+  static constexpr std::size_t HEADER_BYTE_COUNT{127};
+  /**
+   * Readers fetch the header and the root directory in one request of this size.
+   */
+  static constexpr std::size_t ROOT_DIRECTORY_END{16 << 10};
+  static constexpr std::size_t MAX_QUEUED_TILE_COUNT{1024};
+
+  ~PmTilesExporter() override = default;
+
+  /**
+   * Export the given QCT file to the specified path as a PMTiles archive, replacing an existing file.
+   *
+   * @param qct_file The QCT file to export.
+   * @param options The export options for the PMTiles export.
+   */
+  void exportTo(const QctFile& qct_file, const PmTilesExportOptions& options) const;
+
+  /**
+   * @param tile_coordinates of a tile
+   * @return the ID of the tile in a PMTiles archive: the tiles are numbered by zoom level, then along a Hilbert curve
+   */
+  static std::uint64_t tileId(const tiles::TileCoordinates& tile_coordinates);
+
+  /**
+   * A directory entry, pointing to a run of tiles with the same content, or to a leaf directory if the run length is 0.
+   */
+  struct Entry final {
+    std::uint64_t tile_id{};
+    std::uint64_t offset{};
+    std::uint32_t length{};
+    std::uint32_t run_length{};
+  };
+
+  /**
+   * Serialize a directory: the entry count, then the columns of the tile IDs as deltas, the run lengths, the lengths
+   * and the offsets, each as varints. An offset is written as 0 if it follows the previous entry, else incremented.
+   * @param entries ordered by tile ID
+   * @return the bytes of the directory
+   */
+  static std::vector<std::uint8_t> serializeDirectory(std::span<const Entry> entries);
+
+ private:
+  struct Tile final {
+    std::uint64_t tile_id{};
+    std::uint64_t content_hash{};
+    std::vector<std::uint8_t> png_bytes{};
+  };
+
+  /**
+   * The tile data section of the archive.
+   */
+  struct TileData final {
+    std::vector<Entry> entries{};
+    std::uint64_t byte_count{0};
+    std::uint64_t addressed_tile_count{0};
+    std::uint64_t content_count{0};
+  };
+
+  /**
+   * The tiles in the order they are rendered, each content written once to a temporary file, which is removed on
+   * destruction.
+   */
+  class TileSpool final {
+   public:
+    /**
+     * @param path of the temporary file, replaced if it exists
+     * @throws QctExportException if the file cannot be created
+     */
+    explicit TileSpool(std::filesystem::path path);
+    ~TileSpool();
+
+    TileSpool(const TileSpool&) = delete;
+    TileSpool& operator=(const TileSpool&) = delete;
+
+    /**
+     * Add a tile, writing its content unless an earlier tile has the same bytes.
+     * @param tile to add, skipped if it has no content
+     * @throws QctExportException if the tile cannot be written
+     */
+    void add(const Tile& tile);
+
+    /**
+     * Copy the contents into the archive in the order of the tile IDs, so that the tile data is clustered.
+     * @param file the archive, positioned at the start of the tile data
+     * @return the tile data written
+     * @throws QctExportException if the tile data cannot be copied
+     */
+    TileData copyClustered(std::ofstream& file);
+
+   private:
+    std::filesystem::path path_;
+    std::fstream file_{};
+    // One entry per tile, pointing into the temporary file
+    std::vector<Entry> entries_{};
+    // Equal hashes are only candidates, their contents are compared
+    std::unordered_multimap<std::uint64_t, Entry> contents_by_hash_{};
+    std::uint64_t byte_count_{0};
+
+    /**
+     * @param entry of a content in the temporary file
+     * @param bytes to read the content into
+     * @throws QctExportException if the content cannot be read
+     */
+    void read(const Entry& entry, std::vector<std::uint8_t>& bytes);
+  };
+
+  static std::uint64_t contentHash(std::span<const std::uint8_t> bytes);
+  static std::vector<std::uint8_t> serializeMetadata(const QctFile& qct_file, const std::string& name);
+  static void write(std::ostream& file, std::span<const std::uint8_t> bytes);
+};
+
+void PmTilesExporter::exportTo(const QctFile& qct_file, const PmTilesExportOptions& options) const {
+  const tiles::WebMercatorRenderer renderer{qct_file};
+  const ZoomRange zoom_range = ZoomRange::resolve(renderer, qct_file, options.min_zoom, options.max_zoom);
+  std::ofstream file{options.path, std::ios::binary | std::ios::trunc};
+  if (!file) {
+    throw QctExportException{std::format("Failed to open {}", options.path.string())};
+  }
+  // Reserves the space of the header and the root directory, which are only known at the end
+  write(file, std::vector<std::uint8_t>(ROOT_DIRECTORY_END));
+
+  // The levels are rendered bottom-up, but clustered archives order the tile data by tile ID, from the lowest level
+  TileSpool tile_spool{std::filesystem::path{options.path} += ".tiles"};
+  util::BoundedQueue<Tile> tile_queue{MAX_QUEUED_TILE_COUNT};
+  std::exception_ptr writer_exception{};
+  std::thread writer{[&] {
+    try {
+      while (const std::optional<Tile> tile = tile_queue.pop()) {
+        tile_spool.add(*tile);
+      }
+    } catch (...) {
+      writer_exception = std::current_exception();
+    }
+    // Fails the renderers still pushing tiles
+    tile_queue.close();
+  }};
+  std::exception_ptr render_exception{};
+  try {
+    renderPyramid(qct_file, zoom_range, *options.thread_pool,
+                  [&](const tiles::TileCoordinates& tile_coordinates, std::vector<std::uint8_t> png_bytes) {
+                    const std::uint64_t content_hash = contentHash(png_bytes);
+                    if (!tile_queue.push({.tile_id = tileId(tile_coordinates),
+                                          .content_hash = content_hash,
+                                          .png_bytes = std::move(png_bytes)})) {
+                      throw QctExportException{"Failed to write tiles, the writer stopped"};
+                    }
+                  });
+  } catch (...) {
+    render_exception = std::current_exception();
+  }
+  tile_queue.close();
+  writer.join();
+  if (writer_exception) {
+    std::rethrow_exception(writer_exception);
+  }
+  if (render_exception) {
+    std::rethrow_exception(render_exception);
+  }
+  const TileData tile_data = tile_spool.copyClustered(file);
+
+  // The root directory must fit in front of the tile data, larger directories are split into leaf directories
+  std::vector<std::uint8_t> root_directory = serializeDirectory(tile_data.entries);
+  std::vector<std::uint8_t> leaf_directories{};
+  for (std::size_t leaf_entry_count = 4096; ROOT_DIRECTORY_END < HEADER_BYTE_COUNT + root_directory.size();
+       leaf_entry_count *= 2) {
+    leaf_directories.clear();
+    std::vector<Entry> root_entries{};
+    for (std::size_t begin = 0; begin < tile_data.entries.size(); begin += leaf_entry_count) {
+      const std::span<const Entry> leaf_entries = std::span{tile_data.entries}.subspan(
+          begin, std::min(leaf_entry_count, tile_data.entries.size() - begin));
+      const std::vector<std::uint8_t> leaf_directory = serializeDirectory(leaf_entries);
+      root_entries.push_back({.tile_id = leaf_entries.front().tile_id,
+                              .offset = leaf_directories.size(),
+                              .length = static_cast<std::uint32_t>(leaf_directory.size()),
+                              .run_length = 0});
+      leaf_directories.insert(leaf_directories.end(), leaf_directory.begin(), leaf_directory.end());
+    }
+    root_directory = serializeDirectory(root_entries);
+  }
+  const std::vector<std::uint8_t> metadata = serializeMetadata(qct_file, options.path.stem().string());
+  const std::uint64_t metadata_offset = ROOT_DIRECTORY_END + tile_data.byte_count;
+  const std::uint64_t leaf_directories_offset = metadata_offset + metadata.size();
+  write(file, metadata);
+  write(file, leaf_directories);
+
+  std::vector<std::uint8_t> header{'P', 'M', 'T', 'i', 'l', 'e', 's', 3};
+  const auto append = [&header](const std::uint64_t value, const std::size_t byte_count) {
+    for (std::size_t i = 0; i < byte_count; ++i) {
+      header.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+  };
+  const auto append_coordinates = [&append](const double longitude, const double latitude) {
+    append(static_cast<std::uint32_t>(static_cast<std::int32_t>(std::lround(longitude * 1e7))), 4);
+    append(static_cast<std::uint32_t>(static_cast<std::int32_t>(std::lround(latitude * 1e7))), 4);
+  };
+  for (const std::uint64_t value :
+       {std::uint64_t{HEADER_BYTE_COUNT}, std::uint64_t{root_directory.size()}, metadata_offset,
+        std::uint64_t{metadata.size()}, leaf_directories_offset, std::uint64_t{leaf_directories.size()},
+        std::uint64_t{ROOT_DIRECTORY_END}, tile_data.byte_count, tile_data.addressed_tile_count,
+        std::uint64_t{tile_data.entries.size()}, tile_data.content_count}) {
+    append(value, 8);
+  }
+  append(1, 1);  // Clustered, the tile data is ordered by tile ID
+  append(1, 1);  // Directories are not compressed
+  append(1, 1);  // Tiles are not compressed, beyond PNG itself
+  append(2, 1);  // PNG tiles
+  append(zoom_range.min_zoom, 1);
+  append(zoom_range.max_zoom, 1);
+  const auto [min_longitude, min_latitude, max_longitude, max_latitude] = renderer.bounds();
+  append_coordinates(min_longitude, min_latitude);
+  append_coordinates(max_longitude, max_latitude);
+  append(zoom_range.max_zoom, 1);
+  append_coordinates((min_longitude + max_longitude) / 2, (min_latitude + max_latitude) / 2);
+  file.seekp(0);
+  write(file, header);
+  write(file, root_directory);
+}
+
+std::uint64_t PmTilesExporter::tileId(const tiles::TileCoordinates& tile_coordinates) {
+  const auto [z, x, y] = tile_coordinates;
+  // Skips the tiles of all lower zoom levels, (4^z - 1) / 3
+  std::uint64_t tile_id = ((std::uint64_t{1} << (2 * z)) - 1) / 3;
+  const std::uint64_t n = std::uint64_t{1} << z;
+  std::uint64_t hilbert_x = x;
+  std::uint64_t hilbert_y = y;
+  for (std::uint64_t s = n / 2; s > 0; s /= 2) {
+    const std::uint64_t rx = (hilbert_x & s) == 0 ? 0 : 1;
+    const std::uint64_t ry = (hilbert_y & s) == 0 ? 0 : 1;
+    tile_id += s * s * ((3 * rx) ^ ry);
+    // Rotates the quadrant, so that the curve continues where it left the previous quadrant
+    if (ry == 0) {
+      if (rx == 1) {
+        hilbert_x = n - 1 - hilbert_x;
+        hilbert_y = n - 1 - hilbert_y;
+      }
+      std::swap(hilbert_x, hilbert_y);
+    }
+  }
+  return tile_id;
+}
+
+std::uint64_t PmTilesExporter::contentHash(const std::span<const std::uint8_t> bytes) {
+  // 64-bit FNV-1a
+  std::uint64_t hash{0xcbf29ce484222325};
+  for (const std::uint8_t byte : bytes) {
+    hash = (hash ^ byte) * 0x100000001b3;
+  }
+  return hash;
+}
+
+PmTilesExporter::TileSpool::TileSpool(std::filesystem::path path)
+    : path_{std::move(path)}, file_{path_, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc} {
+  if (!file_) {
+    throw QctExportException{std::format("Failed to open {}", path_.string())};
+  }
+}
+
+PmTilesExporter::TileSpool::~TileSpool() {
+  file_.close();
+  std::error_code error_code{};
+  remove(path_, error_code);
+}
+
+void PmTilesExporter::TileSpool::add(const Tile& tile) {
+  if (tile.png_bytes.empty()) {
+    return;
+  }
+  const auto length = static_cast<std::uint32_t>(tile.png_bytes.size());
+  std::optional<std::uint64_t> offset{};
+  std::vector<std::uint8_t> content_bytes{};
+  const auto [begin, end] = contents_by_hash_.equal_range(tile.content_hash);
+  for (auto it = begin; it != end && !offset; ++it) {
+    if (it->second.length == length) {
+      read(it->second, content_bytes);
+      if (content_bytes == tile.png_bytes) {
+        offset = it->second.offset;
+      }
+    }
+  }
+  if (!offset) {
+    offset = byte_count_;
+    // Reading moved the position of the file
+    file_.seekp(0, std::ios::end);
+    write(file_, tile.png_bytes);
+    byte_count_ += length;
+    contents_by_hash_.emplace(tile.content_hash,
+                              Entry{.tile_id = tile.tile_id, .offset = *offset, .length = length, .run_length = 1});
+  }
+  entries_.push_back({.tile_id = tile.tile_id, .offset = *offset, .length = length, .run_length = 1});
+}
+
+PmTilesExporter::TileData PmTilesExporter::TileSpool::copyClustered(std::ofstream& file) {
+  std::ranges::sort(entries_, {}, &Entry::tile_id);
+  TileData tile_data{.addressed_tile_count = entries_.size()};
+  // The offsets of the contents copied so far, in the temporary file and in the archive
+  std::unordered_map<std::uint64_t, std::uint64_t> offsets{};
+  std::vector<std::uint8_t> png_bytes{};
+  for (const Entry& spooled_entry : entries_) {
+    const auto [it, inserted] = offsets.try_emplace(spooled_entry.offset, tile_data.byte_count);
+    if (inserted) {
+      read(spooled_entry, png_bytes);
+      write(file, png_bytes);
+      tile_data.byte_count += spooled_entry.length;
+      ++tile_data.content_count;
+    }
+    // Consecutive tiles with the same content share an entry
+    Entry* const last_entry = tile_data.entries.empty() ? nullptr : &tile_data.entries.back();
+    if (last_entry != nullptr && last_entry->tile_id + last_entry->run_length == spooled_entry.tile_id &&
+        last_entry->offset == it->second && last_entry->length == spooled_entry.length) {
+      ++last_entry->run_length;
+    } else {
+      tile_data.entries.push_back({.tile_id = spooled_entry.tile_id,
+                                   .offset = it->second,
+                                   .length = spooled_entry.length,
+                                   .run_length = 1});
+    }
+  }
+  return tile_data;
+}
+
+void PmTilesExporter::TileSpool::read(const Entry& entry, std::vector<std::uint8_t>& bytes) {
+  bytes.resize(entry.length);
+  file_.seekg(static_cast<std::streamoff>(entry.offset));
+  file_.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+  if (!file_) {
+    throw QctExportException{std::format("Failed to read {}", path_.string())};
+  }
+}
+
+std::vector<std::uint8_t> PmTilesExporter::serializeDirectory(const std::span<const Entry> entries) {
+  std::vector<std::uint8_t> bytes{};
+  const auto append_varint = [&bytes](std::uint64_t value) {
+    for (; 0x80 <= value; value >>= 7) {
+      bytes.push_back(static_cast<std::uint8_t>(value | 0x80));
+    }
+    bytes.push_back(static_cast<std::uint8_t>(value));
+  };
+  // Column by column: the tile IDs as deltas, the run lengths, the lengths, then the offsets, 0 if contiguous
+  append_varint(entries.size());
+  std::uint64_t last_tile_id{0};
+  for (const Entry& entry : entries) {
+    append_varint(entry.tile_id - last_tile_id);
+    last_tile_id = entry.tile_id;
+  }
+  for (const Entry& entry : entries) {
+    append_varint(entry.run_length);
+  }
+  for (const Entry& entry : entries) {
+    append_varint(entry.length);
+  }
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    const bool contiguous = 0 < i && entries[i].offset == entries[i - 1].offset + entries[i - 1].length;
+    append_varint(contiguous ? 0 : entries[i].offset + 1);
+  }
+  return bytes;
+}
+
+std::vector<std::uint8_t> PmTilesExporter::serializeMetadata(const QctFile& qct_file, const std::string& name) {
+  const auto json_string = [](const std::string_view value) {
+    std::string json{"\""};
+    for (const char c : value) {
+      if (c == '"' || c == '\\') {
+        json += std::format("\\{}", c);
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        json += std::format("\\u{:04x}", static_cast<unsigned char>(c));
+      } else {
+        json += c;
+      }
+    }
+    return json + "\"";
+  };
+  const std::string json = std::format(R"({{"name":{},"description":{},"attribution":{},"type":"baselayer"}})",
+                                       json_string(qct_file.metadata.name.empty() ? name : qct_file.metadata.name),
+                                       json_string(qct_file.metadata.long_title),
+                                       json_string(qct_file.metadata.copyright));
+  return {json.begin(), json.end()};
+}
+
+void PmTilesExporter::write(std::ostream& file, const std::span<const std::uint8_t> bytes) {
+  file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+  if (!file) {
+    throw QctExportException{"Failed to write PMTiles archive"};
+  }
+}
+
+}  // namespace qct::ex
@@ -1,7 +1,12 @@
 module;
 
+#include <cstdint>
 #include <filesystem>
+#include <memory>
 #include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
 
 #include "fpng.h"
 
@@ -36,10 +41,63 @@ class PngExporter final : public AbstractExporter<PngExporter, PngExportOptions>
    */
   void exportTo(const QctFile& qct_file, const PngExportOptions& options) const;
 
+  /**
+   * Start exporting the given QCT file as a PNG file, to be fed with the bands of the image.
+   *
+   * @param qct_file The QCT file to export, must outlive the export.
+   * @param options The export options for the PNG export.
+   * @return the export in progress
+   */
+  [[nodiscard]] std::unique_ptr<BandExport> startBandExport(const QctFile& qct_file,
+                                                            const PngExportOptions& options) const;
+
+  /**
+   * Encode an image as PNG in memory.
+   * @param pixels the interleaved pixels in row-major order
+   * @param width of the image
+   * @param height of the image
+   * @param channel_count 3 for RGB, 4 for RGBA
+   * @return the bytes of the PNG file
+   * @throws QctExportException if the image cannot be encoded
+   */
+  static std::vector<std::uint8_t> encode(std::span<const std::uint8_t> pixels, std::int32_t width,
+                                          std::int32_t height, std::int32_t channel_count);
+
  private:
+  class PngBandExport;
+
   static std::once_flag once_flag_;
 };
 
+/**
+ * fpng only encodes a whole RGB(A) image at once, the bands are expanded into it as they are decoded.
+ */
+class PngExporter::PngBandExport final : public BandExport {
+ public:
+  PngBandExport(const QctFile& qct_file, std::filesystem::path path)
+      : qct_file_{qct_file},
+        path_{std::move(path)},
+        row_byte_count_{static_cast<std::size_t>(qct_file.width()) * palette::COLOR_CHANNELS},
+        rgb_bytes_(row_byte_count_ * qct_file.height()) {}
+
+  void write(const image::ImageBand& band) override {
+    band.expandRgb(qct_file_.palette, std::span{rgb_bytes_}.subspan(band.y * row_byte_count_));
+  }
+
+  void finish() override {
+    if (!fpng::fpng_encode_image_to_file(path_.string().c_str(), rgb_bytes_.data(), qct_file_.width(),
+                                         qct_file_.height(), palette::COLOR_CHANNELS, 0)) {
+      throw QctExportException{"Failed to export PNG file."};
+    }
+  }
+
+ private:
+  const QctFile& qct_file_;
+  std::filesystem::path path_;
+  std::size_t row_byte_count_;
+  std::vector<std::uint8_t> rgb_bytes_;
+};
+
 std::once_flag PngExporter::once_flag_{};
 
 PngExporter::PngExporter() {
@@ -47,10 +105,25 @@ PngExporter::PngExporter() {
 }
 
 void PngExporter::exportTo(const QctFile& qct_file, const PngExportOptions& options) const {
-  if (!fpng::fpng_encode_image_to_file(options.path.string().c_str(), qct_file.image_index.imageBytesView().data(),
-                                       qct_file.width(), qct_file.height(), palette::COLOR_CHANNELS, 0)) {
-    throw QctExportException{"Failed to export PNG file."};
+  exportBands(qct_file, *startBandExport(qct_file, options));
+}
+
+std::unique_ptr<BandExport> PngExporter::startBandExport(const QctFile& qct_file,
+                                                         const PngExportOptions& options) const {
+  return std::make_unique<PngBandExport>(qct_file, options.path);
+}
+
+std::vector<std::uint8_t> PngExporter::encode(const std::span<const std::uint8_t> pixels, const std::int32_t width,
+                                              const std::int32_t height, const std::int32_t channel_count) {
+  std::call_once(once_flag_, fpng::fpng_init);
+  if (pixels.size() < static_cast<std::size_t>(width) * height * channel_count) {
+    throw QctExportException{"Failed to encode PNG, too few pixels."};
+  }
+  std::vector<std::uint8_t> png_bytes{};
+  if (!fpng::fpng_encode_image_to_memory(pixels.data(), width, height, channel_count, png_bytes, 0)) {
+    throw QctExportException{"Failed to encode PNG."};
   }
+  return png_bytes;
 }
 
 }  // namespace qct::ex
@@ -0,0 +1,327 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <future>
+#include <optional>
+#include <utility>
+#include <vector>
+
+export module qctexport:pyramid;
+
+import qct;
+
+import :exception;
+import :exporter;
+import :png;
+
+export namespace qct::ex {
+/**
+ * The base options of exporting a QCT file as a tile pyramid.
+ */
+struct PyramidExportOptions : ExportOptions {
+  util::ThreadPool* thread_pool;
+  std::optional<std::int32_t> min_zoom{};
+  std::optional<std::int32_t> max_zoom{};
+
+ protected:
+  /**
+   * @param path to export to
+   * @param thread_pool to render the tiles with
+   * @param min_zoom the lowest zoom level, or empty for the default
+   * @param max_zoom the highest zoom level, or empty for the native zoom level of the image
+   */
+  PyramidExportOptions(const std::filesystem::path& path, util::ThreadPool& thread_pool,
+                       const std::optional<std::int32_t> min_zoom, const std::optional<std::int32_t> max_zoom)
+      : ExportOptions{path}, thread_pool{&thread_pool}, min_zoom{min_zoom}, max_zoom{max_zoom} {}
+};
+
+/**
+ * The inclusive range of zoom levels of a tile pyramid.
+ */
+struct ZoomRange final {
+  std::int32_t min_zoom{};
+  std::int32_t max_zoom{};
+
+  /**
+   * Resolve the zoom levels of a pyramid. By default, the pyramid reaches from the native zoom level of the image
+   * down to the level at which the whole image fits into about a single tile.
+   * @param renderer of the QCT-file
+   * @param qct_file the QCT-file
+   * @param min_zoom the lowest zoom level, or empty for the default
+   * @param max_zoom the highest zoom level, or empty for the default
+   * @return the zoom range
+   * @throws QctExportException if the zoom levels are invalid
+   */
+  static ZoomRange resolve(const tiles::WebMercatorRenderer& renderer, const QctFile& qct_file,
+                           std::optional<std::int32_t> min_zoom, std::optional<std::int32_t> max_zoom);
+};
+
+/**
+ * The highest zoom level of a pyramid is rendered in blocks of 2^n x 2^n tiles, from which the levels above are
+ * downsampled.
+ */
+inline constexpr std::int32_t PYRAMID_BLOCK_ZOOM_LEVELS{3};
+
+/**
+ * The amount of blocks rendered at once, so that the thread pool does not idle while a block is finishing.
+ */
+inline constexpr std::int32_t PYRAMID_BLOCKS_IN_FLIGHT{4};
+
+/**
+ * The bytes of the RGBA pixels held at most while rendering a block of a pyramid and downsampling the levels within it.
+ */
+inline constexpr std::size_t PYRAMID_BLOCK_BYTE_COUNT{((std::size_t{1} << (2 * PYRAMID_BLOCK_ZOOM_LEVELS + 2)) - 1) /
+                                                     3 * tiles::WebMercatorRenderer::TILE_SIZE *
+                                                     tiles::WebMercatorRenderer::TILE_SIZE *
+                                                     tiles::WebMercatorRenderer::CHANNELS};
+
+using pyramid_tile_consumer_t =
+    std::function<void(const tiles::TileCoordinates& tile_coordinates, std::vector<std::uint8_t> png_bytes)>;
+
+/**
+ * Render the tiles of all zoom levels of a pyramid in parallel, and encode them as PNG. Only the tiles of the highest
+ * zoom level sample the image, every tile below is downsampled from its four tiles of the next level, so that the
+ * image is decoded once and the lower levels do not alias. Tiles outside the image are skipped.
+ * @param qct_file the QCT-file, the image must be available
+ * @param zoom_range the zoom levels to render
+ * @param thread_pool to render the tiles with
+ * @param tile_consumer invoked with every PNG tile, concurrently from the workers of the thread pool. A tile is
+ * consumed after the tiles it is downsampled from
+ * @throws QctException if the image tiles cannot be decoded
+ * @throws QctExportException if a tile cannot be encoded
+ */
+void renderPyramid(const QctFile& qct_file, const ZoomRange& zoom_range, util::ThreadPool& thread_pool,
+                   const pyramid_tile_consumer_t& tile_consumer);
+
+ZoomRange ZoomRange::resolve(const tiles::WebMercatorRenderer& renderer, const QctFile& qct_file,
+                             const std::optional<std::int32_t> min_zoom, const std::optional<std::int32_t> max_zoom) {
+  const std::int32_t resolved_max_zoom = max_zoom.value_or(renderer.nativeZoom());
+  // Every zoom level out halves the image, until it fits into a tile
+  const double tile_widths = static_cast<double>(std::max(qct_file.width(), qct_file.height())) /
+                             tiles::WebMercatorRenderer::TILE_SIZE;
+  const auto zoom_out_count = static_cast<std::int32_t>(std::ceil(std::log2(std::max(tile_widths, 1.0))));
+  const std::int32_t resolved_min_zoom =
+      min_zoom.value_or(std::clamp(renderer.nativeZoom() - zoom_out_count, 0, resolved_max_zoom));
+  if (resolved_min_zoom < 0 || resolved_max_zoom < resolved_min_zoom ||
+      tiles::WebMercatorRenderer::MAX_ZOOM < resolved_max_zoom) {
+    throw QctExportException{std::format("Invalid zoom levels {} to {}, must be within 0 to {}", resolved_min_zoom,
+                                         resolved_max_zoom, tiles::WebMercatorRenderer::MAX_ZOOM)};
+  }
+  return {.min_zoom = resolved_min_zoom, .max_zoom = resolved_max_zoom};
+}
+
+}  // namespace qct::ex
+
+namespace qct::ex {
+/**
+ * Renders a pyramid bottom-up. The highest zoom level is rendered in blocks of tiles, which are submitted to the thread
+ * pool a few at a time in depth-first order. A block renders its quadrants in parallel, recursively, and downsamples
+ * every tile as soon as its children are done. The levels above the blocks are downsampled from the finished blocks in
+ * the same order, so that only the pixels of the blocks in flight and of the siblings along the way up are held.
+ */
+class PyramidRenderer final {
+ public:
+  /**
+   * @param qct_file the QCT-file, the image must be available
+   * @param zoom_range the zoom levels to render
+   * @param thread_pool to render the tiles with
+   * @param tile_consumer invoked with every PNG tile
+   */
+  PyramidRenderer(const QctFile& qct_file, const ZoomRange& zoom_range, util::ThreadPool& thread_pool,
+                  const pyramid_tile_consumer_t& tile_consumer);
+
+  /**
+   * Render all tiles of the pyramid.
+   * @throws QctException if the image tiles cannot be decoded
+   * @throws QctExportException if a tile cannot be encoded
+   */
+  void render();
+
+ private:
+  using rgba_tile_t = std::vector<std::uint8_t>;
+
+  tiles::WebMercatorRenderer renderer_;
+  ZoomRange zoom_range_;
+  util::ThreadPool& thread_pool_;
+  const pyramid_tile_consumer_t& tile_consumer_;
+  // The zoom level of the block tiles, at most PYRAMID_BLOCK_ZOOM_LEVELS above the highest level of the pyramid
+  std::int32_t block_zoom_;
+  // The tiles overlapping the image, by zoom level
+  std::vector<tiles::TileRange> tile_ranges_{};
+  // The block tiles in the order they are consumed, and the blocks submitted but not consumed yet
+  std::vector<tiles::TileCoordinates> block_tiles_{};
+  std::size_t next_block_index_{0};
+  std::deque<std::future<rgba_tile_t>> block_futures_{};
+
+  /**
+   * Render a tile above the block tiles from its children, recursively.
+   * @return the RGBA pixels of the tile, empty outside the image
+   */
+  [[nodiscard]] rgba_tile_t renderTile(const tiles::TileCoordinates& tile_coordinates);
+
+  /**
+   * Render a tile at or below the block tiles, downsampled from its children rendered in parallel, recursively.
+   * @return the RGBA pixels of the tile, empty outside the image
+   */
+  [[nodiscard]] rgba_tile_t renderBlockTile(const tiles::TileCoordinates& tile_coordinates) const;
+
+  /**
+   * Wait for the next block in depth-first order, and submit the block after the ones in flight.
+   * @return the RGBA pixels of the block tile
+   */
+  [[nodiscard]] rgba_tile_t nextBlock();
+
+  /**
+   * Collect the block tiles within a tile in depth-first order, the order in which renderTile consumes them.
+   */
+  void collectBlockTiles(const tiles::TileCoordinates& tile_coordinates);
+
+  void submitBlock();
+
+  /**
+   * @return the tiles within the given tile at zoom level z which overlap the image
+   */
+  [[nodiscard]] tiles::TileRange tileRange(const tiles::TileCoordinates& tile_coordinates, std::int32_t z) const;
+
+  void consume(const tiles::TileCoordinates& tile_coordinates, const rgba_tile_t& rgba_tile) const;
+};
+
+PyramidRenderer::PyramidRenderer(const QctFile& qct_file, const ZoomRange& zoom_range, util::ThreadPool& thread_pool,
+                                 const pyramid_tile_consumer_t& tile_consumer)
+    : renderer_{qct_file},
+      zoom_range_{zoom_range},
+      thread_pool_{thread_pool},
+      tile_consumer_{tile_consumer},
+      block_zoom_{std::max(zoom_range.min_zoom, zoom_range.max_zoom - PYRAMID_BLOCK_ZOOM_LEVELS)} {
+  for (std::int32_t z = 0; z <= zoom_range.max_zoom; ++z) {
+    tile_ranges_.push_back(renderer_.tileRange(z));
+  }
+}
+
+void PyramidRenderer::render() {
+  const tiles::TileRange& top_tile_range = tile_ranges_[zoom_range_.min_zoom];
+  for (std::int32_t index = 0; index < top_tile_range.count(); ++index) {
+    collectBlockTiles(top_tile_range.at(index));
+  }
+  try {
+    while (block_futures_.size() < static_cast<std::size_t>(PYRAMID_BLOCKS_IN_FLIGHT) &&
+           next_block_index_ < block_tiles_.size()) {
+      submitBlock();
+    }
+    for (std::int32_t index = 0; index < top_tile_range.count(); ++index) {
+      static_cast<void>(block_zoom_ == zoom_range_.min_zoom ? nextBlock() : renderTile(top_tile_range.at(index)));
+    }
+  } catch (...) {
+    // The blocks still in flight reference the renderer
+    for (std::future<rgba_tile_t>& block_future : block_futures_) {
+      try {
+        static_cast<void>(thread_pool_.wait(block_future));
+      } catch (...) {
+      }
+    }
+    throw;
+  }
+}
+
+PyramidRenderer::rgba_tile_t PyramidRenderer::renderTile(const tiles::TileCoordinates& tile_coordinates) {
+  const auto [z, x, y] = tile_coordinates;
+  std::array<rgba_tile_t, 4> child_tiles{};
+  for (std::int32_t child_index = 0; child_index < 4; ++child_index) {
+    const tiles::TileCoordinates child_coordinates{
+        .z = z + 1, .x = 2 * x + child_index % 2, .y = 2 * y + child_index / 2};
+    if (tileRange(child_coordinates, z + 1).count() == 0) {
+      continue;
+    }
+    child_tiles[child_index] = child_coordinates.z == block_zoom_ ? nextBlock() : renderTile(child_coordinates);
+  }
+  rgba_tile_t rgba_tile = tiles::WebMercatorRenderer::downsample(child_tiles);
+  consume(tile_coordinates, rgba_tile);
+  return rgba_tile;
+}
+
+PyramidRenderer::rgba_tile_t PyramidRenderer::renderBlockTile(const tiles::TileCoordinates& tile_coordinates) const {
+  const auto [z, x, y] = tile_coordinates;
+  rgba_tile_t rgba_tile{};
+  if (z == zoom_range_.max_zoom) {
+    rgba_tile = renderer_.render(tile_coordinates);
+  } else {
+    std::array<rgba_tile_t, 4> child_tiles{};
+    thread_pool_.parallelFor(4, [&](const std::int32_t child_index) {
+      const tiles::TileCoordinates child_coordinates{
+          .z = z + 1, .x = 2 * x + child_index % 2, .y = 2 * y + child_index / 2};
+      if (tileRange(child_coordinates, z + 1).count() != 0) {
+        child_tiles[child_index] = renderBlockTile(child_coordinates);
+      }
+    });
+    rgba_tile = tiles::WebMercatorRenderer::downsample(child_tiles);
+  }
+  consume(tile_coordinates, rgba_tile);
+  return rgba_tile;
+}
+
+PyramidRenderer::rgba_tile_t PyramidRenderer::nextBlock() {
+  rgba_tile_t rgba_tile = thread_pool_.wait(block_futures_.front());
+  block_futures_.pop_front();
+  if (next_block_index_ < block_tiles_.size()) {
+    submitBlock();
+  }
+  return rgba_tile;
+}
+
+void PyramidRenderer::collectBlockTiles(const tiles::TileCoordinates& tile_coordinates) {
+  if (tile_coordinates.z == block_zoom_) {
+    block_tiles_.push_back(tile_coordinates);
+    return;
+  }
+  const auto [z, x, y] = tile_coordinates;
+  for (std::int32_t child_index = 0; child_index < 4; ++child_index) {
+    const tiles::TileCoordinates child_coordinates{
+        .z = z + 1, .x = 2 * x + child_index % 2, .y = 2 * y + child_index / 2};
+    if (tileRange(child_coordinates, z + 1).count() != 0) {
+      collectBlockTiles(child_coordinates);
+    }
+  }
+}
+
+void PyramidRenderer::submitBlock() {
+  block_futures_.push_back(thread_pool_.submit(
+      [this, block_tile = block_tiles_[next_block_index_++]] { return renderBlockTile(block_tile); }));
+}
+
+tiles::TileRange PyramidRenderer::tileRange(const tiles::TileCoordinates& tile_coordinates,
+                                            const std::int32_t z) const {
+  const tiles::TileRange& image_tile_range = tile_ranges_[z];
+  const std::int32_t shift = z - tile_coordinates.z;
+  const tiles::TileRange tile_range{.z = z,
+                                    .min_x = std::max(tile_coordinates.x << shift, image_tile_range.min_x),
+                                    .min_y = std::max(tile_coordinates.y << shift, image_tile_range.min_y),
+                                    .max_x = std::min(((tile_coordinates.x + 1) << shift) - 1, image_tile_range.max_x),
+                                    .max_y = std::min(((tile_coordinates.y + 1) << shift) - 1, image_tile_range.max_y)};
+  if (tile_range.width() <= 0 || tile_range.height() <= 0) {
+    return {.z = z};
+  }
+  return tile_range;
+}
+
+void PyramidRenderer::consume(const tiles::TileCoordinates& tile_coordinates, const rgba_tile_t& rgba_tile) const {
+  if (rgba_tile.empty()) {
+    return;
+  }
+  tile_consumer_(tile_coordinates,
+                 PngExporter::encode(rgba_tile, tiles::WebMercatorRenderer::TILE_SIZE,
+                                     tiles::WebMercatorRenderer::TILE_SIZE, tiles::WebMercatorRenderer::CHANNELS));
+}
+
+void renderPyramid(const QctFile& qct_file, const ZoomRange& zoom_range, util::ThreadPool& thread_pool,
+                   const pyramid_tile_consumer_t& tile_consumer) {
+  PyramidRenderer{qct_file, zoom_range, thread_pool, tile_consumer}.render();
+}
+
+}  // namespace qct::ex
@@ -4,6 +4,7 @@ module;
 #include <iostream>
 #include <memory>
 #include <stdexcept>
+#include <vector>
 
 export module qctexport;
 
@@ -13,7 +14,11 @@ export import :exception;
 export import :exporter;
 export import :geotiff;
 export import :kml;
+export import :mbtiles;
+export import :pmtiles;
 export import :png;
+export import :pyramid;
+export import :xyz;
 
 export namespace qct::ex {
 /**
@@ -21,9 +26,10 @@ export namespace qct::ex {
  * @tparam O export options type
  * @param qct_file the QCT file to be exported
  * @param export_options the export options
+ * @return whether the export succeeded, the reason of a failure is printed
  */
 template <typename O>
-void exportToFormat(const QctFile& qct_file, const O& export_options) {
+bool exportToFormat(const QctFile& qct_file, const O& export_options) {
   try {
     if constexpr (std::is_same_v<O, GeoTiffExportOptions>) {
       const GeoTiffExporter exporter{};
@@ -34,9 +40,89 @@ void exportToFormat(const QctFile& qct_file, const O& export_options) {
     } else if constexpr (std::is_same_v<O, PngExportOptions>) {
       const PngExporter exporter{};
       exporter.exportTo(qct_file, export_options);
+    } else if constexpr (std::is_same_v<O, MbTilesExportOptions>) {
+      const MbTilesExporter exporter{};
+      exporter.exportTo(qct_file, export_options);
+    } else if constexpr (std::is_same_v<O, PmTilesExportOptions>) {
+      const PmTilesExporter exporter{};
+      exporter.exportTo(qct_file, export_options);
+    } else if constexpr (std::is_same_v<O, XyzExportOptions>) {
+      const XyzExporter exporter{};
+      exporter.exportTo(qct_file, export_options);
     }
+    return true;
   } catch (const QctExportException& e) {
     std::cerr << "Failed to export: " << e.what() << std::endl;
+  } catch (const QctException& e) {
+    // The image is decoded lazily by the first exporter requesting it
+    std::cerr << "Failed to export: " << e.what() << std::endl;
+  }
+  return false;
+}
+
+/**
+ * Export the given QCT file to several raster formats at once. The image is decoded a single time, and every band is
+ * passed to all exports in turn. A failing export does not stop the others.
+ * @tparam O export options types of raster formats, GeoTiffExportOptions or PngExportOptions
+ * @param qct_file the QCT file to be exported
+ * @param export_options the export options, options with an empty path are skipped
+ * @return whether all exports succeeded, the reasons of failures are printed
+ */
+template <typename... O>
+bool exportToRasterFormats(const QctFile& qct_file, const O&... export_options) {
+  bool succeeded{true};
+  const auto fail = [&succeeded](const std::exception& e) {
+    std::cerr << "Failed to export: " << e.what() << std::endl;
+    succeeded = false;
+  };
+  std::vector<std::unique_ptr<BandExport>> band_exports{};
+  const auto start = [&]<typename T>(const T& options) {
+    if (options.path.empty()) {
+      return;
+    }
+    try {
+      if constexpr (std::is_same_v<T, GeoTiffExportOptions>) {
+        band_exports.push_back(GeoTiffExporter{}.startBandExport(qct_file, options));
+      } else {
+        static_assert(std::is_same_v<T, PngExportOptions>, "Not a raster format");
+        band_exports.push_back(PngExporter{}.startBandExport(qct_file, options));
+      }
+    } catch (const QctExportException& e) {
+      fail(e);
+    }
+  };
+  (start(export_options), ...);
+  if (band_exports.empty()) {
+    return succeeded;
+  }
+  try {
+    qct_file.forEachImageBand([&](const image::ImageBand& band) {
+      for (std::unique_ptr<BandExport>& band_export : band_exports) {
+        if (band_export == nullptr) {
+          continue;
+        }
+        try {
+          band_export->write(band);
+        } catch (const QctExportException& e) {
+          fail(e);
+          band_export.reset();
+        }
+      }
+    });
+  } catch (const QctException& e) {
+    // Without the image, none of the exports can be completed
+    fail(e);
+    return false;
+  }
+  for (const std::unique_ptr<BandExport>& band_export : band_exports) {
+    try {
+      if (band_export != nullptr) {
+        band_export->finish();
+      }
+    } catch (const QctExportException& e) {
+      fail(e);
+    }
   }
+  return succeeded;
 }
 }  // namespace qct::ex
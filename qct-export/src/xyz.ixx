@@ -0,0 +1,73 @@
+module;
+
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+export module qctexport:xyz;
+
+import qct;
+
+import :exception;
+import :exporter;
+import :pyramid;
+
+export namespace qct::ex {
+/**
+ * Options for exporting a QCT file to a directory of XYZ tiles.
+ */
+struct XyzExportOptions final : PyramidExportOptions {
+  /**
+   * @param path the directory to write the tiles to
+   * @param thread_pool to render the tiles with
+   * @param min_zoom the lowest zoom level, or empty for the default
+   * @param max_zoom the highest zoom level, or empty for the native zoom level of the image
+   */
+  XyzExportOptions(const std::filesystem::path& path, util::ThreadPool& thread_pool,
+                   const std::optional<std::int32_t> min_zoom = std::nullopt,
+                   const std::optional<std::int32_t> max_zoom = std::nullopt)
+      : PyramidExportOptions{path, thread_pool, min_zoom, max_zoom} {}
+};
+
+/**
+ * Exporter for XYZ tiles: a pyramid of 256 x 256 PNG tiles in the Web Mercator projection, at {z}/{x}/{y}.png.
+ */
+class XyzExporter final : public AbstractExporter<XyzExporter, XyzExportOptions> {
+ public:
+  ~XyzExporter() override = default;
+
+  /**
+   * Export the given QCT file as XYZ tiles into the directory of the options.
+   *
+   * @param qct_file The QCT file to export.
+   * @param options The export options for the XYZ export.
+   */
+  void exportTo(const QctFile& qct_file, const XyzExportOptions& options) const;
+};
+
+void XyzExporter::exportTo(const QctFile& qct_file, const XyzExportOptions& options) const {
+  const ZoomRange zoom_range =
+      ZoomRange::resolve(tiles::WebMercatorRenderer{qct_file}, qct_file, options.min_zoom, options.max_zoom);
+  renderPyramid(qct_file, zoom_range, *options.thread_pool,
+                [&](const tiles::TileCoordinates& tile_coordinates, const std::vector<std::uint8_t>& png_bytes) {
+                  const std::filesystem::path directory = options.path / std::to_string(tile_coordinates.z) /
+                                                          std::to_string(tile_coordinates.x);
+                  // Tiles of the same column are rendered concurrently, an existing directory is no error
+                  std::error_code error_code{};
+                  create_directories(directory, error_code);
+                  const std::filesystem::path tile_path = directory / std::format("{}.png", tile_coordinates.y);
+                  std::ofstream file{tile_path, std::ios::binary};
+                  file.write(reinterpret_cast<const char*>(png_bytes.data()),
+                             static_cast<std::streamsize>(png_bytes.size()));
+                  if (!file) {
+                    throw QctExportException{std::format("Failed to write {}", tile_path.string())};
+                  }
+                });
+}
+
+}  // namespace qct::ex
@@ -0,0 +1,93 @@
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+import qct;
+import qctexport;
+
+using namespace qct;
+using Entry = ex::PmTilesExporter::Entry;
+
+namespace {
+/**
+ * Parse a directory the way PMTiles readers do.
+ */
+std::vector<Entry> parseDirectory(const std::span<const std::uint8_t> bytes) {
+  std::size_t position{0};
+  const auto read_varint = [&] {
+    std::uint64_t value{0};
+    for (std::int32_t shift = 0;; shift += 7) {
+      const std::uint8_t byte = bytes[position++];
+      value |= std::uint64_t{byte & 0x7Fu} << shift;
+      if (byte < 0x80) {
+        return value;
+      }
+    }
+  };
+  std::vector<Entry> entries(read_varint());
+  std::uint64_t tile_id{0};
+  for (Entry& entry : entries) {
+    tile_id += read_varint();
+    entry.tile_id = tile_id;
+  }
+  for (Entry& entry : entries) {
+    entry.run_length = static_cast<std::uint32_t>(read_varint());
+  }
+  for (Entry& entry : entries) {
+    entry.length = static_cast<std::uint32_t>(read_varint());
+  }
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    const std::uint64_t offset = read_varint();
+    entries[i].offset = offset == 0 && 0 < i ? entries[i - 1].offset + entries[i - 1].length : offset - 1;
+  }
+  EXPECT_EQ(position, bytes.size());
+  return entries;
+}
+}  // namespace
+
+TEST(PmTilesExporterTest, TileIdsFollowTheHilbertCurveByZoomLevel) {
+  EXPECT_EQ(ex::PmTilesExporter::tileId({.z = 0, .x = 0, .y = 0}), 0);
+  EXPECT_EQ(ex::PmTilesExporter::tileId({.z = 1, .x = 0, .y = 0}), 1);
+  EXPECT_EQ(ex::PmTilesExporter::tileId({.z = 1, .x = 0, .y = 1}), 2);
+  EXPECT_EQ(ex::PmTilesExporter::tileId({.z = 1, .x = 1, .y = 1}), 3);
+  EXPECT_EQ(ex::PmTilesExporter::tileId({.z = 1, .x = 1, .y = 0}), 4);
+  EXPECT_EQ(ex::PmTilesExporter::tileId({.z = 2, .x = 0, .y = 0}), 5);
+  EXPECT_EQ(ex::PmTilesExporter::tileId({.z = 2, .x = 3, .y = 3}), 15);
+  EXPECT_EQ(ex::PmTilesExporter::tileId({.z = 12, .x = 3423, .y = 1763}), 19078479);
+}
+
+TEST(PmTilesExporterTest, SerializeDirectoryWritesColumnsOfVarints) {
+  const std::vector<Entry> entries{{.tile_id = 0, .offset = 0, .length = 10, .run_length = 1},
+                                   {.tile_id = 1, .offset = 10, .length = 200, .run_length = 3}};
+  // The count, the tile ID deltas, the run lengths, the lengths, then the first offset plus 1 and a contiguous one
+  const std::vector<std::uint8_t> expected{2, 0, 1, 1, 3, 10, 0xC8, 0x01, 1, 0};
+  EXPECT_EQ(ex::PmTilesExporter::serializeDirectory(entries), expected);
+}
+
+TEST(PmTilesExporterTest, SerializedDirectoryRoundTrips) {
+  const std::vector<Entry> entries{
+      {.tile_id = 0, .offset = 0, .length = 10, .run_length = 1},
+      // Contiguous to the previous entry
+      {.tile_id = 1, .offset = 10, .length = 300, .run_length = 4},
+      // A run of duplicates, pointing back to the first content
+      {.tile_id = 5, .offset = 0, .length = 10, .run_length = 1000},
+      {.tile_id = 20000, .offset = 310, .length = 7, .run_length = 1},
+      {.tile_id = 20001, .offset = 317, .length = 70000, .run_length = 1},
+      // A leaf directory
+      {.tile_id = 19078479, .offset = 1 << 20, .length = 4096, .run_length = 0}};
+  const std::vector<Entry> parsed_entries = parseDirectory(ex::PmTilesExporter::serializeDirectory(entries));
+  ASSERT_EQ(parsed_entries.size(), entries.size());
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    EXPECT_EQ(parsed_entries[i].tile_id, entries[i].tile_id) << i;
+    EXPECT_EQ(parsed_entries[i].offset, entries[i].offset) << i;
+    EXPECT_EQ(parsed_entries[i].length, entries[i].length) << i;
+    EXPECT_EQ(parsed_entries[i].run_length, entries[i].run_length) << i;
+  }
+}
+
+TEST(PmTilesExporterTest, SerializeEmptyDirectory) {
+  EXPECT_EQ(ex::PmTilesExporter::serializeDirectory({}), std::vector<std::uint8_t>{0});
+}
@@ -0,0 +1,20 @@
+module;
+
+#include <string>
+#include <utility>
+
+export module qctserve:exception;
+
+export namespace qct::serve {
+struct QctServeException final : std::exception {
+  explicit QctServeException(std::string message) : message_(std::move(message)) {}
+  [[nodiscard]] const char* what() const noexcept override;
+
+ private:
+  std::string message_;
+};
+
+const char* QctServeException::what() const noexcept {
+  return message_.c_str();
+}
+}  // namespace qct::serve
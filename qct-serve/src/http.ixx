@@ -0,0 +1,135 @@
+module;
+
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module qctserve:http;
+
+export namespace qct::serve {
+/**
+ * The request line of an HTTP/1.x request, the headers are not needed to serve tiles.
+ */
+struct HttpRequest final {
+  std::string method{};
+  std::string path{};
+  std::string version{};
+
+  /**
+   * Parse the head of a request.
+   * @param head the request line and headers, up to the empty line
+   * @return the request, or empty if the request line is malformed
+   */
+  static std::optional<HttpRequest> parse(std::string_view head);
+};
+
+struct HttpResponse final {
+  std::int32_t status_code{200};
+  std::string content_type{"text/plain; charset=utf-8"};
+  std::vector<std::uint8_t> body{};
+
+  /**
+   * @param status_code of the response
+   * @param message the plain text body
+   * @return the response
+   */
+  static HttpResponse text(std::int32_t status_code, std::string_view message);
+
+  /**
+   * Serialize the status line and headers. Every response closes the connection.
+   * @return the head of the response, including the empty line
+   */
+  [[nodiscard]] std::string head() const;
+};
+
+/**
+ * Decode the percent-encoded octets of a URL path.
+ * @param path to decode
+ * @return the decoded path, or empty if an escape is malformed
+ */
+std::optional<std::string> percentDecode(std::string_view path);
+
+std::optional<HttpRequest> HttpRequest::parse(const std::string_view head) {
+  const std::string_view request_line = head.substr(0, head.find("\r\n"));
+  const std::size_t method_end = request_line.find(' ');
+  const std::size_t target_end = request_line.rfind(' ');
+  if (method_end == std::string_view::npos || method_end == target_end) {
+    return std::nullopt;
+  }
+  const std::string_view version = request_line.substr(target_end + 1);
+  if (!version.starts_with("HTTP/1.")) {
+    return std::nullopt;
+  }
+  std::string_view target = request_line.substr(method_end + 1, target_end - method_end - 1);
+  target = target.substr(0, target.find_first_of("?#"));
+  if (!target.starts_with('/')) {
+    return std::nullopt;
+  }
+  return HttpRequest{.method = std::string{request_line.substr(0, method_end)},
+                     .path = std::string{target},
+                     .version = std::string{version}};
+}
+
+HttpResponse HttpResponse::text(const std::int32_t status_code, const std::string_view message) {
+  return {.status_code = status_code, .body = {message.begin(), message.end()}};
+}
+
+std::string HttpResponse::head() const {
+  const auto reason_phrase = [this] {
+    switch (status_code) {
+      case 200:
+        return "OK";
+      case 400:
+        return "Bad Request";
+      case 404:
+        return "Not Found";
+      case 405:
+        return "Method Not Allowed";
+      case 431:
+        return "Request Header Fields Too Large";
+      default:
+        return "Internal Server Error";
+    }
+  };
+  return std::format(
+      "HTTP/1.1 {} {}\r\n"
+      "Content-Type: {}\r\n"
+      "Content-Length: {}\r\n"
+      "Connection: close\r\n"
+      "\r\n",
+      status_code, reason_phrase(), content_type, body.size());
+}
+
+std::optional<std::string> percentDecode(const std::string_view path) {
+  const auto hex_value = [](const char c) -> std::int32_t {
+    if ('0' <= c && c <= '9') {
+      return c - '0';
+    }
+    if ('a' <= c && c <= 'f') {
+      return c - 'a' + 10;
+    }
+    if ('A' <= c && c <= 'F') {
+      return c - 'A' + 10;
+    }
+    return -1;
+  };
+  std::string decoded{};
+  decoded.reserve(path.size());
+  for (std::size_t i = 0; i < path.size(); ++i) {
+    if (path[i] != '%') {
+      decoded += path[i];
+      continue;
+    }
+    if (path.size() <= i + 2 || hex_value(path[i + 1]) < 0 || hex_value(path[i + 2]) < 0) {
+      return std::nullopt;
+    }
+    decoded += static_cast<char>(hex_value(path[i + 1]) * 16 + hex_value(path[i + 2]));
+    i += 2;
+  }
+  return decoded;
+}
+
+}  // namespace qct::serve
@@ -0,0 +1,151 @@
+module;
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <chrono>
+#include <exception>
+#include <format>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+export module qctserve:maps;
+
+import qct;
+
+import :exception;
+import :renderer;
+
+export namespace qct::serve {
+/**
+ * A QCT-file served under a name.
+ */
+struct MapSource final {
+  std::string name{};
+  std::filesystem::path qct_file_path{};
+};
+
+/**
+ * The served QCT-files, opened on first use. The most recently used files stay open, memory-mapped together with
+ * their decoded and downsampled tiles, so requests for hot maps neither parse nor decode anything again. Thread-safe.
+ */
+class MapRegistry final {
+ public:
+  /**
+   * @param map_sources the served QCT-files
+   * @param thread_pool to decode images with, must outlive the registry
+   * @param max_open_map_count how many QCT-files stay open at most
+   * @param force_decode whether to attempt decoding despite an unknown magic number or file format version
+   * @param decode_options options for decoding the image tiles, the tile cache budget of each map is shared by its
+   * decoded image tiles and its downsampled tiles
+   * @throws QctServeException if two QCT-files have the same name
+   */
+  MapRegistry(std::vector<MapSource> map_sources, util::ThreadPool& thread_pool, std::size_t max_open_map_count,
+              bool force_decode, const image::DecodeOptions& decode_options);
+
+  MapRegistry(const MapRegistry&) = delete;
+  MapRegistry& operator=(const MapRegistry&) = delete;
+
+  [[nodiscard]] const std::vector<MapSource>& mapSources() const { return map_sources_; }
+
+  /**
+   * Get the renderer of an open QCT-file, opening it unless already open.
+   * @param name of the map
+   * @return the renderer, which stays valid after being closed by the registry, or nullptr if no map has the name
+   * @throws QctException if the QCT-file cannot be parsed
+   */
+  [[nodiscard]] std::shared_ptr<const MapTileRenderer> open(std::string_view name);
+
+ private:
+  // A quarter of the tile cache budget of a map holds downsampled tiles
+  static constexpr std::size_t DOWNSAMPLED_CACHE_SHARE{4};
+
+  // Ready once the QCT-file is parsed, so that the lock is not held while parsing
+  using renderer_future_t = std::shared_future<std::shared_ptr<const MapTileRenderer>>;
+  using entry_t = std::pair<std::size_t, renderer_future_t>;
+
+  const std::vector<MapSource> map_sources_;
+  util::ThreadPool& thread_pool_;
+  const std::size_t max_open_map_count_;
+  const bool force_decode_;
+  const image::DecodeOptions decode_options_;
+  std::unordered_map<std::string_view, std::size_t> source_index_by_name_{};
+  std::list<entry_t> open_maps_{};  // The most recently used first
+  std::mutex mutex_{};
+};
+
+MapRegistry::MapRegistry(std::vector<MapSource> map_sources, util::ThreadPool& thread_pool,
+                         const std::size_t max_open_map_count, const bool force_decode,
+                         const image::DecodeOptions& decode_options)
+    : map_sources_{std::move(map_sources)},
+      thread_pool_{thread_pool},
+      max_open_map_count_{std::max<std::size_t>(max_open_map_count, 1)},
+      force_decode_{force_decode},
+      decode_options_{decode_options} {
+  for (std::size_t i = 0; i < map_sources_.size(); ++i) {
+    const auto [it, inserted] = source_index_by_name_.emplace(map_sources_[i].name, i);
+    if (!inserted) {
+      throw QctServeException{std::format("Ambiguous map name {}: {} and {}", map_sources_[i].name,
+                                          map_sources_[it->second].qct_file_path.string(),
+                                          map_sources_[i].qct_file_path.string())};
+    }
+  }
+}
+
+std::shared_ptr<const MapTileRenderer> MapRegistry::open(const std::string_view name) {
+  const auto source_it = source_index_by_name_.find(name);
+  if (source_it == source_index_by_name_.end()) {
+    return nullptr;
+  }
+  const std::size_t source_index = source_it->second;
+  std::promise<std::shared_ptr<const MapTileRenderer>> promise{};
+  renderer_future_t renderer_future{};
+  bool opening{false};
+  {
+    std::lock_guard lock{mutex_};
+    if (const auto it = std::ranges::find(open_maps_, source_index, &entry_t::first); it != open_maps_.end()) {
+      open_maps_.splice(open_maps_.begin(), open_maps_, it);
+      renderer_future = it->second;
+    } else {
+      renderer_future = promise.get_future().share();
+      open_maps_.emplace_front(source_index, renderer_future);
+      if (max_open_map_count_ < open_maps_.size()) {
+        open_maps_.pop_back();
+      }
+      opening = true;
+    }
+  }
+  if (!opening) {
+    // Another request may still be parsing the QCT-file
+    return renderer_future.get();
+  }
+  try {
+    // Only the header is parsed here, the tiles are decoded as the requests need them
+    const std::size_t downsampled_cache_byte_count = decode_options_.tile_cache_byte_count / DOWNSAMPLED_CACHE_SHARE;
+    image::DecodeOptions decode_options = decode_options_;
+    decode_options.tile_cache_byte_count -= downsampled_cache_byte_count;
+    auto map_tile_renderer = std::make_shared<const MapTileRenderer>(
+        std::make_shared<const QctFile>(
+            QctFile::parse(map_sources_[source_index].qct_file_path, thread_pool_, force_decode_, decode_options)),
+        downsampled_cache_byte_count);
+    promise.set_value(map_tile_renderer);
+    return map_tile_renderer;
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+    // Forget the failed map, so that the next request retries it
+    std::lock_guard lock{mutex_};
+    std::erase_if(open_maps_, [source_index](const entry_t& entry) {
+      return entry.first == source_index && entry.second.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+    });
+    throw;
+  }
+}
+
+}  // namespace qct::serve
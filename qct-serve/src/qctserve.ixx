@@ -0,0 +1,8 @@
+export module qctserve;
+
+export import :exception;
+export import :http;
+export import :maps;
+export import :renderer;
+export import :server;
+export import :socket;
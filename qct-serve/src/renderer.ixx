@@ -0,0 +1,157 @@
+module;
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+export module qctserve:renderer;
+
+import qct;
+
+export namespace qct::serve {
+/**
+ * Renders the tiles of a map on request. Tiles at or above the native zoom level sample the image, every tile below it
+ * is downsampled from its four children, which are rendered in parallel. The downsampled tiles are cached, so that a
+ * tile far below the native zoom level decodes the image it covers once, not once per request. Thread-safe.
+ */
+class MapTileRenderer final {
+ public:
+  /**
+   * @param qct_file the QCT-file of the map
+   * @param cache_byte_count the byte budget of the cached downsampled tiles, 0 to disable caching
+   */
+  MapTileRenderer(std::shared_ptr<const QctFile> qct_file, std::size_t cache_byte_count);
+
+  MapTileRenderer(const MapTileRenderer&) = delete;
+  MapTileRenderer& operator=(const MapTileRenderer&) = delete;
+
+  [[nodiscard]] const QctFile& qctFile() const { return *qct_file_; }
+
+  /**
+   * Render a tile.
+   * @param tile_coordinates of the tile, must be valid
+   * @param thread_pool to render the children of a downsampled tile with
+   * @return the RGBA pixels of the tile, or empty if the tile does not overlap the image
+   * @throws QctException if the image tiles cannot be decoded
+   */
+  [[nodiscard]] std::vector<std::uint8_t> render(const tiles::TileCoordinates& tile_coordinates,
+                                                 util::ThreadPool& thread_pool) const;
+
+  /**
+   * @return the amount of bytes of the currently cached downsampled tiles
+   */
+  [[nodiscard]] std::size_t cachedByteCount() const;
+
+ private:
+  using rgba_tile_t = std::shared_ptr<const std::vector<std::uint8_t>>;
+  using entry_t = std::pair<std::uint64_t, rgba_tile_t>;
+
+  std::shared_ptr<const QctFile> qct_file_;
+  tiles::WebMercatorRenderer renderer_;
+  std::int32_t native_zoom_;
+  // The tiles overlapping the image, by zoom level up to the native one
+  std::vector<tiles::TileRange> tile_ranges_{};
+  const std::size_t cache_byte_count_;
+  mutable std::size_t cached_byte_count_{0};
+  mutable std::list<entry_t> cached_tiles_{};  // The most recently used first
+  mutable std::unordered_map<std::uint64_t, std::list<entry_t>::iterator> cached_tile_by_key_{};
+  mutable std::mutex cache_mutex_{};
+
+  [[nodiscard]] rgba_tile_t renderDownsampled(const tiles::TileCoordinates& tile_coordinates,
+                                              util::ThreadPool& thread_pool) const;
+  [[nodiscard]] bool overlaps(const tiles::TileCoordinates& tile_coordinates) const;
+  [[nodiscard]] rgba_tile_t findCached(std::uint64_t key) const;
+  void cache(std::uint64_t key, const rgba_tile_t& rgba_tile) const;
+};
+
+MapTileRenderer::MapTileRenderer(std::shared_ptr<const QctFile> qct_file, const std::size_t cache_byte_count)
+    : qct_file_{std::move(qct_file)},
+      renderer_{*qct_file_},
+      native_zoom_{renderer_.nativeZoom()},
+      cache_byte_count_{cache_byte_count} {
+  for (std::int32_t z = 0; z <= native_zoom_; ++z) {
+    tile_ranges_.push_back(renderer_.tileRange(z));
+  }
+}
+
+std::vector<std::uint8_t> MapTileRenderer::render(const tiles::TileCoordinates& tile_coordinates,
+                                                  util::ThreadPool& thread_pool) const {
+  if (native_zoom_ <= tile_coordinates.z) {
+    return renderer_.render(tile_coordinates);
+  }
+  if (!overlaps(tile_coordinates)) {
+    return {};
+  }
+  const rgba_tile_t rgba_tile = renderDownsampled(tile_coordinates, thread_pool);
+  return *rgba_tile;
+}
+
+std::size_t MapTileRenderer::cachedByteCount() const {
+  std::lock_guard lock{cache_mutex_};
+  return cached_byte_count_;
+}
+
+MapTileRenderer::rgba_tile_t MapTileRenderer::renderDownsampled(const tiles::TileCoordinates& tile_coordinates,
+                                                                util::ThreadPool& thread_pool) const {
+  const auto [z, x, y] = tile_coordinates;
+  const std::uint64_t key = std::uint64_t{static_cast<std::uint32_t>(z)} << 48 |
+                            std::uint64_t{static_cast<std::uint32_t>(x)} << 24 | static_cast<std::uint32_t>(y);
+  if (rgba_tile_t rgba_tile = findCached(key)) {
+    return rgba_tile;
+  }
+  std::array<std::vector<std::uint8_t>, 4> child_tiles{};
+  thread_pool.parallelFor(4, [&](const std::int32_t child_index) {
+    const tiles::TileCoordinates child_coordinates{
+        .z = z + 1, .x = 2 * x + child_index % 2, .y = 2 * y + child_index / 2};
+    if (!overlaps(child_coordinates)) {
+      return;
+    }
+    child_tiles[child_index] = child_coordinates.z == native_zoom_
+                                   ? renderer_.render(child_coordinates)
+                                   : *renderDownsampled(child_coordinates, thread_pool);
+  });
+  auto rgba_tile =
+      std::make_shared<const std::vector<std::uint8_t>>(tiles::WebMercatorRenderer::downsample(child_tiles));
+  cache(key, rgba_tile);
+  return rgba_tile;
+}
+
+bool MapTileRenderer::overlaps(const tiles::TileCoordinates& tile_coordinates) const {
+  const tiles::TileRange& tile_range = tile_ranges_[tile_coordinates.z];
+  return tile_range.min_x <= tile_coordinates.x && tile_coordinates.x <= tile_range.max_x &&
+         tile_range.min_y <= tile_coordinates.y && tile_coordinates.y <= tile_range.max_y;
+}
+
+MapTileRenderer::rgba_tile_t MapTileRenderer::findCached(const std::uint64_t key) const {
+  std::lock_guard lock{cache_mutex_};
+  const auto it = cached_tile_by_key_.find(key);
+  if (it == cached_tile_by_key_.end()) {
+    return nullptr;
+  }
+  cached_tiles_.splice(cached_tiles_.begin(), cached_tiles_, it->second);
+  return it->second->second;
+}
+
+void MapTileRenderer::cache(const std::uint64_t key, const rgba_tile_t& rgba_tile) const {
+  const std::size_t tile_byte_count = rgba_tile->size();
+  std::lock_guard lock{cache_mutex_};
+  if (cache_byte_count_ < tile_byte_count || cached_tile_by_key_.contains(key)) {
+    return;
+  }
+  while (cache_byte_count_ - tile_byte_count < cached_byte_count_) {
+    cached_byte_count_ -= cached_tiles_.back().second->size();
+    cached_tile_by_key_.erase(cached_tiles_.back().first);
+    cached_tiles_.pop_back();
+  }
+  cached_byte_count_ += tile_byte_count;
+  cached_tiles_.emplace_front(key, rgba_tile);
+  cached_tile_by_key_.emplace(key, cached_tiles_.begin());
+}
+
+}  // namespace qct::serve
@@ -0,0 +1,252 @@
+module;
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+export module qctserve:server;
+
+import qct;
+import qctexport;
+
+import :exception;
+import :http;
+import :maps;
+import :renderer;
+import :socket;
+
+export namespace qct::serve {
+/**
+ * Where the tile server listens.
+ */
+struct ServeOptions final {
+  std::string host{"127.0.0.1"};
+  std::uint16_t port{8080};
+  /**
+   * Listen on this Unix domain socket instead of the TCP port, if not empty.
+   */
+  std::filesystem::path unix_socket_path{};
+  /**
+   * The amount of threads receiving requests and sending responses, apart from the threads rendering the tiles.
+   */
+  std::int32_t connection_thread_count{8};
+};
+
+/**
+ * An HTTP server rendering the tiles of the maps on request, at /{map}/{z}/{x}/{y}.png in the XYZ tiling scheme.
+ * Every connection serves a single request. Its request and response are transferred by a dedicated connection thread,
+ * so that slow clients cannot stall the thread pool, which only renders and encodes the tiles. Tiles at or above the
+ * native zoom level of a map only decode the image tiles they cover, tiles below it are downsampled from cached tiles
+ * of the next level.
+ */
+class TileServer final {
+ public:
+  static constexpr std::size_t MAX_REQUEST_HEAD_BYTE_COUNT{8 << 10};
+  static constexpr std::chrono::seconds CONNECTION_TIMEOUT{10};
+
+  /**
+   * Bind the server, it does not accept connections before it runs.
+   * @param map_registry the served maps, must outlive the server
+   * @param thread_pool to render the tiles on, must outlive the server
+   * @param options where to listen and how many connection threads to use
+   * @throws QctServeException if the server cannot listen
+   */
+  TileServer(MapRegistry& map_registry, util::ThreadPool& thread_pool, const ServeOptions& options);
+
+  /**
+   * @return the TCP port the server listens on, 0 for a Unix domain socket
+   */
+  [[nodiscard]] std::uint16_t port() const { return port_; }
+
+  /**
+   * Accept connections until stopped, then wait for the connections in progress.
+   * @throws QctServeException if accepting connections fails
+   */
+  void run();
+
+  /**
+   * Stop a running server. Safe to call from any thread.
+   */
+  void stop();
+
+  /**
+   * Respond to a request.
+   * @param request the request
+   * @return the response
+   */
+  [[nodiscard]] HttpResponse respond(const HttpRequest& request) const;
+
+ private:
+  MapRegistry& map_registry_;
+  util::ThreadPool& thread_pool_;
+  Socket listen_socket_;
+  std::uint16_t port_{0};
+  std::atomic<bool> stopped_{false};
+  std::int32_t connection_count_{0};
+  std::mutex connection_mutex_{};
+  std::condition_variable connection_condition_{};
+  util::ThreadPool connection_thread_pool_;
+
+  void serve(const Socket& connection) const;
+  [[nodiscard]] HttpResponse respondWithTile(std::string_view path) const;
+};
+
+TileServer::TileServer(MapRegistry& map_registry, util::ThreadPool& thread_pool, const ServeOptions& options)
+    : map_registry_{map_registry},
+      thread_pool_{thread_pool},
+      listen_socket_{options.unix_socket_path.empty() ? Socket::listenTcp(options.host, options.port)
+                                                      : Socket::listenUnix(options.unix_socket_path)},
+      connection_thread_pool_{std::max(1, options.connection_thread_count)} {
+  if (options.unix_socket_path.empty()) {
+    port_ = listen_socket_.localPort();
+  }
+}
+
+void TileServer::run() {
+  while (!stopped_) {
+    Socket connection{};
+    try {
+      connection = listen_socket_.accept();
+    } catch (const QctServeException&) {
+      if (stopped_) {
+        break;
+      }
+      throw;
+    }
+    {
+      std::lock_guard lock{connection_mutex_};
+      ++connection_count_;
+    }
+    static_cast<void>(connection_thread_pool_.submit([this, connection = std::move(connection)]() mutable {
+      // The connection is closed before the server may be gone
+      const Socket job_connection = std::move(connection);
+      serve(job_connection);
+      std::lock_guard lock{connection_mutex_};
+      --connection_count_;
+      connection_condition_.notify_all();
+    }));
+  }
+  std::unique_lock lock{connection_mutex_};
+  connection_condition_.wait(lock, [this] { return connection_count_ == 0; });
+}
+
+void TileServer::stop() {
+  stopped_ = true;
+  listen_socket_.shutdown();
+}
+
+void TileServer::serve(const Socket& connection) const {
+  try {
+    connection.setTimeout(CONNECTION_TIMEOUT);
+    std::string head{};
+    std::vector<char> buffer(4096);
+    std::size_t head_end{std::string::npos};
+    while ((head_end = head.find("\r\n\r\n")) == std::string::npos) {
+      if (MAX_REQUEST_HEAD_BYTE_COUNT < head.size()) {
+        break;
+      }
+      const std::size_t byte_count = connection.receive(buffer);
+      if (byte_count == 0) {
+        return;
+      }
+      head.append(buffer.data(), byte_count);
+    }
+    const std::optional<HttpRequest> request =
+        head_end == std::string::npos ? std::nullopt : HttpRequest::parse(std::string_view{head}.substr(0, head_end));
+    HttpResponse response{};
+    if (head_end == std::string::npos) {
+      response = HttpResponse::text(431, "Request head too large");
+    } else if (!request) {
+      response = HttpResponse::text(400, "Malformed request");
+    } else if (request->method != "GET" && request->method != "HEAD") {
+      response = HttpResponse::text(405, "Only GET and HEAD are supported");
+    } else {
+      // This thread keeps the connection, the thread pool is only busy while rendering
+      std::future<HttpResponse> response_future = thread_pool_.submit([this, &request] { return respond(*request); });
+      response = thread_pool_.wait(response_future);
+    }
+    const std::string response_head = response.head();
+    connection.sendAll(response_head);
+    if (!request || request->method != "HEAD") {
+      connection.sendAll(std::span{reinterpret_cast<const char*>(response.body.data()), response.body.size()});
+    }
+  } catch (const QctServeException&) {
+    // The client went away or timed out, there is nobody left to respond to
+  }
+}
+
+HttpResponse TileServer::respond(const HttpRequest& request) const {
+  const std::optional<std::string> path = percentDecode(request.path);
+  if (!path) {
+    return HttpResponse::text(400, "Malformed path");
+  }
+  if (*path == "/") {
+    std::string map_names{};
+    for (const MapSource& map_source : map_registry_.mapSources()) {
+      map_names += std::format("{}\n", map_source.name);
+    }
+    return HttpResponse::text(200, map_names);
+  }
+  return respondWithTile(*path);
+}
+
+HttpResponse TileServer::respondWithTile(const std::string_view path) const {
+  // The map name may contain slashes itself, so the path is split from the end: /{map}/{z}/{x}/{y}.png
+  if (!path.ends_with(".png")) {
+    return HttpResponse::text(404, "Not found");
+  }
+  std::string_view rest = path.substr(1, path.size() - 5);
+  std::int32_t tile_coordinates[3]{};
+  for (std::int32_t i = 2; i >= 0; --i) {
+    const std::size_t separator = rest.rfind('/');
+    if (separator == std::string_view::npos) {
+      return HttpResponse::text(404, "Not found");
+    }
+    const std::string_view number = rest.substr(separator + 1);
+    const auto [end, error_code] = std::from_chars(number.data(), number.data() + number.size(), tile_coordinates[i]);
+    if (error_code != std::errc{} || end != number.data() + number.size()) {
+      return HttpResponse::text(400, std::format("Malformed tile coordinate {}", number));
+    }
+    rest = rest.substr(0, separator);
+  }
+  const auto [z, x, y] = tile_coordinates;
+  if (z < 0 || tiles::WebMercatorRenderer::MAX_ZOOM < z || x < 0 || (1 << z) <= x || y < 0 || (1 << z) <= y) {
+    return HttpResponse::text(404, std::format("No tile z={}, x={}, y={}", z, x, y));
+  }
+  try {
+    const std::shared_ptr<const MapTileRenderer> map_tile_renderer = map_registry_.open(rest);
+    if (map_tile_renderer == nullptr) {
+      return HttpResponse::text(404, std::format("Unknown map {}", rest));
+    }
+    const std::vector<std::uint8_t> rgba_bytes = map_tile_renderer->render({.z = z, .x = x, .y = y}, thread_pool_);
+    if (rgba_bytes.empty()) {
+      return HttpResponse::text(404, std::format("Map {} does not cover z={}, x={}, y={}", rest, z, x, y));
+    }
+    return {.status_code = 200,
+            .content_type = "image/png",
+            .body = ex::PngExporter::encode(rgba_bytes, tiles::WebMercatorRenderer::TILE_SIZE,
+                                            tiles::WebMercatorRenderer::TILE_SIZE,
+                                            tiles::WebMercatorRenderer::CHANNELS)};
+  } catch (const std::exception& e) {
+    std::cerr << path << ": " << e.what() << std::endl;
+    return HttpResponse::text(500, e.what());
+  }
+}
+
+}  // namespace qct::serve
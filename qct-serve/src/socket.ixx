@@ -0,0 +1,344 @@
+module;
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <mutex>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#else
+#include <cerrno>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+export module qctserve:socket;
+
+import :exception;
+
+export namespace qct::serve {
+/**
+ * A blocking stream socket, closed on destruction.
+ */
+class Socket final {
+ public:
+#ifdef _WIN32
+  using native_handle_t = SOCKET;
+  static constexpr native_handle_t INVALID_HANDLE{INVALID_SOCKET};
+#else
+  using native_handle_t = int;
+  static constexpr native_handle_t INVALID_HANDLE{-1};
+#endif
+
+  Socket() = default;
+  explicit Socket(const native_handle_t handle) : handle_{handle} {}
+  ~Socket();
+
+  Socket(const Socket&) = delete;
+  Socket& operator=(const Socket&) = delete;
+  Socket(Socket&& other) noexcept : handle_{std::exchange(other.handle_, INVALID_HANDLE)} {}
+  Socket& operator=(Socket&& other) noexcept;
+
+  /**
+   * Listen on a TCP port.
+   * @param host the address to bind to, e.g. 127.0.0.1 to only accept local connections
+   * @param port the port to bind to, 0 for any free port
+   * @return the listening socket
+   * @throws QctServeException if the address cannot be bound
+   */
+  static Socket listenTcp(const std::string& host, std::uint16_t port);
+
+  /**
+   * Listen on a Unix domain socket. A stale socket file at the path is replaced.
+   * @param path of the socket file
+   * @return the listening socket
+   * @throws QctServeException if the path cannot be bound
+   */
+  static Socket listenUnix(const std::filesystem::path& path);
+
+  /**
+   * Connect to a TCP port.
+   * @param host the address to connect to
+   * @param port the port to connect to
+   * @return the connected socket
+   * @throws QctServeException if no connection can be established
+   */
+  static Socket connectTcp(const std::string& host, std::uint16_t port);
+
+  /**
+   * Wait for the next connection.
+   * @return the connected socket
+   * @throws QctServeException if the socket was shut down or accepting failed
+   */
+  [[nodiscard]] Socket accept() const;
+
+  /**
+   * @return the TCP port the socket is bound to
+   */
+  [[nodiscard]] std::uint16_t localPort() const;
+
+  /**
+   * Limit how long receiving and sending may block.
+   * @param timeout the limit
+   */
+  void setTimeout(std::chrono::milliseconds timeout) const;
+
+  /**
+   * Receive the next bytes.
+   * @param buffer to receive into
+   * @return the amount of received bytes, 0 once the peer closed the connection
+   * @throws QctServeException if receiving failed or timed out
+   */
+  [[nodiscard]] std::size_t receive(std::span<char> buffer) const;
+
+  /**
+   * Send all bytes.
+   * @param bytes to send
+   * @throws QctServeException if sending failed or timed out
+   */
+  void sendAll(std::span<const char> bytes) const;
+
+  /**
+   * Stop sending and receiving, which also wakes up a thread blocked in accept.
+   */
+  void shutdown() const noexcept;
+
+ private:
+  native_handle_t handle_{INVALID_HANDLE};
+
+  static void startup();
+  static std::string lastErrorMessage();
+  void close() noexcept;
+};
+
+Socket::~Socket() {
+  close();
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept {
+  if (this != &other) {
+    close();
+    handle_ = std::exchange(other.handle_, INVALID_HANDLE);
+  }
+  return *this;
+}
+
+Socket Socket::listenTcp(const std::string& host, const std::uint16_t port) {
+  startup();
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+  addrinfo* addresses{nullptr};
+  if (const int error = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses); error != 0) {
+    throw QctServeException{std::format("Failed to resolve {}: {}", host, gai_strerror(error))};
+  }
+  std::string error_message{};
+  for (const addrinfo* address = addresses; address != nullptr; address = address->ai_next) {
+    Socket socket{::socket(address->ai_family, address->ai_socktype, address->ai_protocol)};
+    if (socket.handle_ == INVALID_HANDLE) {
+      error_message = lastErrorMessage();
+      continue;
+    }
+#ifndef _WIN32
+    // Restarting the server must not wait for the connections of the previous run to time out
+    constexpr int reuse_address{1};
+    setsockopt(socket.handle_, SOL_SOCKET, SO_REUSEADDR, &reuse_address, sizeof(reuse_address));
+#endif
+    if (bind(socket.handle_, address->ai_addr, static_cast<socklen_t>(address->ai_addrlen)) == 0 &&
+        listen(socket.handle_, SOMAXCONN) == 0) {
+      freeaddrinfo(addresses);
+      return socket;
+    }
+    error_message = lastErrorMessage();
+  }
+  freeaddrinfo(addresses);
+  throw QctServeException{std::format("Failed to listen on {}:{}: {}", host, port, error_message)};
+}
+
+Socket Socket::listenUnix(const std::filesystem::path& path) {
+  startup();
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  const std::string path_string = path.string();
+  if (sizeof(address.sun_path) <= path_string.size()) {
+    throw QctServeException{std::format("Socket path {} is too long", path_string)};
+  }
+  std::memcpy(address.sun_path, path_string.c_str(), path_string.size() + 1);
+  std::error_code error_code{};
+  if (is_socket(path, error_code)) {
+    remove(path, error_code);
+  }
+  Socket socket{::socket(AF_UNIX, SOCK_STREAM, 0)};
+  if (socket.handle_ == INVALID_HANDLE || bind(socket.handle_, reinterpret_cast<const sockaddr*>(&address),
+                                               sizeof(address)) != 0 || listen(socket.handle_, SOMAXCONN) != 0) {
+    throw QctServeException{std::format("Failed to listen on {}: {}", path_string, lastErrorMessage())};
+  }
+  return socket;
+}
+
+Socket Socket::connectTcp(const std::string& host, const std::uint16_t port) {
+  startup();
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_NUMERICSERV;
+  addrinfo* addresses{nullptr};
+  if (const int error = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses); error != 0) {
+    throw QctServeException{std::format("Failed to resolve {}: {}", host, gai_strerror(error))};
+  }
+  std::string error_message{};
+  for (const addrinfo* address = addresses; address != nullptr; address = address->ai_next) {
+    Socket socket{::socket(address->ai_family, address->ai_socktype, address->ai_protocol)};
+    if (socket.handle_ == INVALID_HANDLE) {
+      error_message = lastErrorMessage();
+      continue;
+    }
+    if (connect(socket.handle_, address->ai_addr, static_cast<socklen_t>(address->ai_addrlen)) == 0) {
+      freeaddrinfo(addresses);
+      return socket;
+    }
+    error_message = lastErrorMessage();
+  }
+  freeaddrinfo(addresses);
+  throw QctServeException{std::format("Failed to connect to {}:{}: {}", host, port, error_message)};
+}
+
+Socket Socket::accept() const {
+  while (true) {
+    const native_handle_t handle = ::accept(handle_, nullptr, nullptr);
+    if (handle != INVALID_HANDLE) {
+      return Socket{handle};
+    }
+#ifndef _WIN32
+    if (errno == EINTR || errno == ECONNABORTED) {
+      continue;
+    }
+#endif
+    throw QctServeException{std::format("Failed to accept a connection: {}", lastErrorMessage())};
+  }
+}
+
+std::uint16_t Socket::localPort() const {
+  sockaddr_storage address{};
+  socklen_t address_length = sizeof(address);
+  if (getsockname(handle_, reinterpret_cast<sockaddr*>(&address), &address_length) != 0) {
+    throw QctServeException{std::format("Failed to get the socket address: {}", lastErrorMessage())};
+  }
+  if (address.ss_family == AF_INET) {
+    return ntohs(reinterpret_cast<const sockaddr_in*>(&address)->sin_port);
+  }
+  if (address.ss_family == AF_INET6) {
+    return ntohs(reinterpret_cast<const sockaddr_in6*>(&address)->sin6_port);
+  }
+  return 0;
+}
+
+void Socket::setTimeout(const std::chrono::milliseconds timeout) const {
+#ifdef _WIN32
+  const auto timeout_value = static_cast<DWORD>(timeout.count());
+#else
+  const timeval timeout_value{.tv_sec = static_cast<time_t>(timeout.count() / 1000),
+                              .tv_usec = static_cast<suseconds_t>(timeout.count() % 1000 * 1000)};
+#endif
+  setsockopt(handle_, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout_value), sizeof(timeout_value));
+  setsockopt(handle_, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout_value), sizeof(timeout_value));
+}
+
+std::size_t Socket::receive(const std::span<char> buffer) const {
+  while (true) {
+    const auto byte_count = recv(handle_, buffer.data(), static_cast<int>(buffer.size()), 0);
+    if (byte_count >= 0) {
+      return static_cast<std::size_t>(byte_count);
+    }
+#ifndef _WIN32
+    if (errno == EINTR) {
+      continue;
+    }
+#endif
+    throw QctServeException{std::format("Failed to receive: {}", lastErrorMessage())};
+  }
+}
+
+void Socket::sendAll(std::span<const char> bytes) const {
+#ifdef MSG_NOSIGNAL
+  // A client hanging up must not kill the server with SIGPIPE
+  constexpr int flags{MSG_NOSIGNAL};
+#else
+  constexpr int flags{0};
+#endif
+  while (!bytes.empty()) {
+    const auto byte_count = send(handle_, bytes.data(), static_cast<int>(bytes.size()), flags);
+    if (byte_count < 0) {
+#ifndef _WIN32
+      if (errno == EINTR) {
+        continue;
+      }
+#endif
+      throw QctServeException{std::format("Failed to send: {}", lastErrorMessage())};
+    }
+    bytes = bytes.subspan(static_cast<std::size_t>(byte_count));
+  }
+}
+
+void Socket::shutdown() const noexcept {
+  if (handle_ != INVALID_HANDLE) {
+#ifdef _WIN32
+    ::shutdown(handle_, SD_BOTH);
+#else
+    ::shutdown(handle_, SHUT_RDWR);
+#endif
+  }
+}
+
+void Socket::startup() {
+#ifdef _WIN32
+  static std::once_flag once_flag{};
+  std::call_once(once_flag, [] {
+    WSADATA wsa_data{};
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+      throw QctServeException{"Failed to initialize Winsock"};
+    }
+  });
+#endif
+}
+
+std::string Socket::lastErrorMessage() {
+#ifdef _WIN32
+  return std::system_category().message(WSAGetLastError());
+#else
+  return std::system_category().message(errno);
+#endif
+}
+
+void Socket::close() noexcept {
+  if (handle_ != INVALID_HANDLE) {
+#ifdef _WIN32
+    closesocket(handle_);
+#else
+    ::close(handle_);
+#endif
+    handle_ = INVALID_HANDLE;
+  }
+}
+
+}  // namespace qct::serve
@@ -0,0 +1,66 @@
+#include <optional>
+#include <string>
+
+#include <gtest/gtest.h>
+
+import qctserve;
+
+using namespace qct::serve;
+
+TEST(HttpRequestTest, ParsesTheRequestLine) {
+  const std::optional<HttpRequest> request =
+      HttpRequest::parse("GET /chart/1/0/1.png HTTP/1.1\r\nHost: localhost\r\nAccept: */*");
+  ASSERT_TRUE(request.has_value());
+  EXPECT_EQ(request->method, "GET");
+  EXPECT_EQ(request->path, "/chart/1/0/1.png");
+  EXPECT_EQ(request->version, "HTTP/1.1");
+}
+
+TEST(HttpRequestTest, StripsQueryAndFragment) {
+  EXPECT_EQ(HttpRequest::parse("GET /chart/0/0/0.png?v=2 HTTP/1.1")->path, "/chart/0/0/0.png");
+  EXPECT_EQ(HttpRequest::parse("GET /chart/0/0/0.png#top HTTP/1.1")->path, "/chart/0/0/0.png");
+  EXPECT_EQ(HttpRequest::parse("GET /?a=b#c HTTP/1.0")->path, "/");
+}
+
+TEST(HttpRequestTest, RejectsMalformedRequestLines) {
+  EXPECT_FALSE(HttpRequest::parse("").has_value());
+  EXPECT_FALSE(HttpRequest::parse("GET").has_value());
+  EXPECT_FALSE(HttpRequest::parse("GET /").has_value());
+  EXPECT_FALSE(HttpRequest::parse("GET chart/0/0/0.png HTTP/1.1").has_value());
+  EXPECT_FALSE(HttpRequest::parse("GET ?a=b HTTP/1.1").has_value());
+  EXPECT_FALSE(HttpRequest::parse("\r\nGET / HTTP/1.1").has_value());
+}
+
+TEST(HttpRequestTest, RejectsOtherVersions) {
+  EXPECT_TRUE(HttpRequest::parse("GET / HTTP/1.0").has_value());
+  EXPECT_FALSE(HttpRequest::parse("GET / HTTP/2.0").has_value());
+  EXPECT_FALSE(HttpRequest::parse("GET / HTTP/1").has_value());
+  EXPECT_FALSE(HttpRequest::parse("GET / FTP/1.1").has_value());
+  EXPECT_FALSE(HttpRequest::parse("GET / http/1.1").has_value());
+}
+
+TEST(HttpResponseTest, HeadDescribesTheBody) {
+  const HttpResponse response = HttpResponse::text(404, "Not found");
+  EXPECT_EQ(response.head(),
+            "HTTP/1.1 404 Not Found\r\n"
+            "Content-Type: text/plain; charset=utf-8\r\n"
+            "Content-Length: 9\r\n"
+            "Connection: close\r\n"
+            "\r\n");
+}
+
+TEST(PercentDecodeTest, DecodesEscapes) {
+  EXPECT_EQ(percentDecode("/Other%20Chart/0/0/0.png"), "/Other Chart/0/0/0.png");
+  EXPECT_EQ(percentDecode("/sub%2fchart"), "/sub/chart");
+  EXPECT_EQ(percentDecode("/%C3%A4"), "/\xC3\xA4");
+  EXPECT_EQ(percentDecode("/plain+path"), "/plain+path");
+  EXPECT_EQ(percentDecode(""), "");
+}
+
+TEST(PercentDecodeTest, RejectsMalformedEscapes) {
+  EXPECT_FALSE(percentDecode("/chart%").has_value());
+  EXPECT_FALSE(percentDecode("/chart%2").has_value());
+  EXPECT_FALSE(percentDecode("/chart%zz").has_value());
+  EXPECT_FALSE(percentDecode("/chart%2g/0/0/0.png").has_value());
+  EXPECT_FALSE(percentDecode("/chart%g2/0/0/0.png").has_value());
+}
@@ -0,0 +1,115 @@
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+import qct;
+import qctserve;
+
+using namespace qct;
+using namespace qct::serve;
+
+namespace {
+/**
+ * A server of two maps whose files do not exist, so that a request reaching a map fails with 500,
+ * while every request rejected before opening the map keeps its own status code.
+ */
+class TileServerTest : public testing::Test {
+ protected:
+  util::ThreadPool thread_pool_{2};
+  MapRegistry map_registry_{{{.name = "chart", .qct_file_path = missingPath("chart.qct")},
+                             {.name = "sub/Other Chart", .qct_file_path = missingPath("Other Chart.qct")}},
+                            thread_pool_,
+                            1,
+                            false,
+                            {}};
+  TileServer tile_server_{map_registry_, thread_pool_, {.host = "127.0.0.1", .port = 0}};
+
+  static std::filesystem::path missingPath(const std::string_view file_name) {
+    return std::filesystem::temp_directory_path() / "qct-serve-test-missing" / file_name;
+  }
+
+  [[nodiscard]] std::int32_t statusCode(const std::string& path) const {
+    return tile_server_.respond({.method = "GET", .path = path, .version = "HTTP/1.1"}).status_code;
+  }
+};
+
+std::string exchange(const std::uint16_t port, const std::string_view request) {
+  const Socket connection = Socket::connectTcp("127.0.0.1", port);
+  connection.sendAll(request);
+  std::string response{};
+  std::vector<char> buffer(4096);
+  while (const std::size_t byte_count = connection.receive(buffer)) {
+    response.append(buffer.data(), byte_count);
+  }
+  return response;
+}
+}  // namespace
+
+TEST_F(TileServerTest, ListsTheMaps) {
+  const HttpResponse response = tile_server_.respond({.method = "GET", .path = "/", .version = "HTTP/1.1"});
+  EXPECT_EQ(response.status_code, 200);
+  EXPECT_EQ(std::string(response.body.begin(), response.body.end()), "chart\nsub/Other Chart\n");
+}
+
+TEST_F(TileServerTest, SplitsMapNamesFromTheEnd) {
+  EXPECT_EQ(statusCode("/chart/0/0/0.png"), 500);
+  EXPECT_EQ(statusCode("/sub/Other%20Chart/0/0/0.png"), 500);
+  EXPECT_EQ(statusCode("/sub%2FOther%20Chart/0/0/0.png"), 500);
+  EXPECT_EQ(statusCode("/sub/0/0/0.png"), 404);
+  EXPECT_EQ(statusCode("/Other%20Chart/0/0/0.png"), 404);
+  EXPECT_EQ(statusCode("/unknown/0/0/0.png"), 404);
+  EXPECT_EQ(statusCode("/0/0/0.png"), 404);
+  EXPECT_EQ(statusCode("/0/0.png"), 404);
+  EXPECT_EQ(statusCode("/chart/0/0/0.jpg"), 404);
+  EXPECT_EQ(statusCode("/chart/0/0/0"), 404);
+}
+
+TEST_F(TileServerTest, RejectsNonNumericTileCoordinates) {
+  EXPECT_EQ(statusCode("/chart/a/0/0.png"), 400);
+  EXPECT_EQ(statusCode("/chart/0/0x1/0.png"), 400);
+  EXPECT_EQ(statusCode("/chart/0/0/.png"), 400);
+  EXPECT_EQ(statusCode("/chart/0/+0/0.png"), 400);
+  EXPECT_EQ(statusCode("/chart/0/%200/0.png"), 400);
+  EXPECT_EQ(statusCode("/chart/99999999999/0/0.png"), 400);
+  EXPECT_EQ(statusCode("/chart/0/0/0%zz.png"), 400);
+}
+
+TEST_F(TileServerTest, RejectsOutOfRangeTileCoordinates) {
+  EXPECT_EQ(statusCode("/chart/-1/0/0.png"), 404);
+  EXPECT_EQ(statusCode("/chart/25/0/0.png"), 404);
+  EXPECT_EQ(statusCode("/chart/1/2/0.png"), 404);
+  EXPECT_EQ(statusCode("/chart/1/0/2.png"), 404);
+  EXPECT_EQ(statusCode("/chart/1/-1/0.png"), 404);
+  EXPECT_EQ(statusCode("/chart/1/1/1.png"), 500);
+}
+
+TEST_F(TileServerTest, ServesOverLoopback) {
+  ASSERT_NE(tile_server_.port(), 0);
+  std::thread server_thread{[this] { tile_server_.run(); }};
+
+  const std::string list_response = exchange(tile_server_.port(), "GET /?v=1 HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  EXPECT_TRUE(list_response.starts_with("HTTP/1.1 200 OK\r\n")) << list_response;
+  EXPECT_TRUE(list_response.ends_with("\r\n\r\nchart\nsub/Other Chart\n")) << list_response;
+
+  const std::string head_response = exchange(tile_server_.port(), "HEAD / HTTP/1.0\r\n\r\n");
+  EXPECT_TRUE(head_response.starts_with("HTTP/1.1 200 OK\r\n")) << head_response;
+  EXPECT_TRUE(head_response.ends_with("\r\n\r\n")) << head_response;
+
+  const std::string unknown_response = exchange(tile_server_.port(), "GET /unknown/0/0/0.png HTTP/1.1\r\n\r\n");
+  EXPECT_TRUE(unknown_response.starts_with("HTTP/1.1 404 Not Found\r\n")) << unknown_response;
+
+  const std::string method_response = exchange(tile_server_.port(), "POST / HTTP/1.1\r\n\r\n");
+  EXPECT_TRUE(method_response.starts_with("HTTP/1.1 405 Method Not Allowed\r\n")) << method_response;
+
+  const std::string malformed_response = exchange(tile_server_.port(), "GET / HTTP/2\r\n\r\n");
+  EXPECT_TRUE(malformed_response.starts_with("HTTP/1.1 400 Bad Request\r\n")) << malformed_response;
+
+  tile_server_.stop();
+  server_thread.join();
+}
@@ -3,8 +3,7 @@ module;
 #include <algorithm>
 #include <array>
 #include <cstdint>
-#include <filesystem>
-#include <fstream>
+#include <ostream>
 #include <ranges>
 #include <vector>
 
@@ -12,6 +11,7 @@ export module qct:georef.coefficients;
 
 import :common.alias;
 import :georef.coordinates;
+import :util.file_source;
 import :util.reader;
 
 export namespace qct::georef {
@@ -86,7 +86,7 @@ struct GeorefCoefficients final {
 
   [[nodiscard]] bool anyNonZeroLonLatSecondOrThirdOrderTerms() const;
 
-  static GeorefCoefficients parse(const std::filesystem::path& filepath);
+  static GeorefCoefficients parse(const util::FileSource& file);
 
   friend std::ostream& operator<<(std::ostream& os, const GeorefCoefficients& georef_coefficients) {
     os << "Georef Coefficients:" << "\n"
@@ -120,8 +120,7 @@ bool GeorefCoefficients::anyNonZeroLonLatSecondOrThirdOrderTerms() const {
   return std::ranges::any_of(terms, [](const double coefficient) { return std::abs(coefficient) > epsilon; });
 }
 
-GeorefCoefficients GeorefCoefficients::parse(const std::filesystem::path& filepath) {
-  std::ifstream file{filepath, std::ios::binary};
+GeorefCoefficients GeorefCoefficients::parse(const util::FileSource& file) {
   const std::vector<double> eas_doubles = util::readDoubles(file, BYTE_OFFSET + 0x00, 10);
   const std::vector<double> nor_doubles = util::readDoubles(file, BYTE_OFFSET + 0x50, 10);
   const std::vector<double> lat_doubles = util::readDoubles(file, BYTE_OFFSET + 0xA0, 10);
@@ -1,14 +1,13 @@
 module;
 
 #include <cmath>
-#include <filesystem>
-#include <fstream>
 
 export module qct:georef;
 
 import :georef.coefficients;
 import :georef.coordinates;
 import :meta.datum;
+import :util.file_source;
 
 export namespace qct::georef {
 /**
@@ -34,7 +33,7 @@ struct Georef {
   [[nodiscard]] ImageCoordinates toImageCoordinates(const Wgs84Coordinates& wgs84_coordinates,
                                                     const meta::DatumShift& datum_shift) const;
 
-  static Georef parse(const std::filesystem::path& filepath);
+  static Georef parse(const util::FileSource& file);
 };
 
 Wgs84Coordinates Georef::toWgs84Coordinates(const ImageCoordinates& image_coordinates,
@@ -100,9 +99,8 @@ ImageCoordinates Georef::toImageCoordinates(const Wgs84Coordinates& wgs84_coordi
   return {.x = x, .y = y};
 }
 
-Georef Georef::parse(const std::filesystem::path& filepath) {
-  std::ifstream file{filepath, std::ios_base::binary};
-  return {.coefficients = GeorefCoefficients::parse(filepath)};
+Georef Georef::parse(const util::FileSource& file) {
+  return {.coefficients = GeorefCoefficients::parse(file)};
 }
 
 }  // namespace qct::georef
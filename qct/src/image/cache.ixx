@@ -0,0 +1,119 @@
+module;
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+export module qct:image.cache;
+
+import :image.tile;
+
+export namespace qct::image {
+/**
+ * A single decoded image tile, in row-major order with rows of ImageTile::WIDTH pixels.
+ */
+struct DecodedTile final {
+  PixelFormat pixel_format{PixelFormat::RGB};
+  std::vector<std::uint8_t> bytes{};
+
+  /**
+   * @param y the row within the tile
+   * @return the bytes of the row
+   */
+  [[nodiscard]] std::span<const std::uint8_t> row(const std::int32_t y) const {
+    const std::size_t row_byte_count = ImageTile::WIDTH * static_cast<std::size_t>(bytesPerPixel(pixel_format));
+    return std::span{bytes}.subspan(y * row_byte_count, row_byte_count);
+  }
+};
+
+/**
+ * A thread-safe cache of decoded image tiles, which evicts the least recently used tiles once the decoded bytes exceed
+ * its byte budget. Tiles are shared, so a tile handed out stays valid after being evicted.
+ */
+class TileCache final {
+ public:
+  /**
+   * @param max_byte_count the byte budget of the decoded tiles, 0 to disable caching
+   */
+  explicit TileCache(std::size_t max_byte_count);
+
+  TileCache(const TileCache&) = delete;
+  TileCache& operator=(const TileCache&) = delete;
+
+  /**
+   * Find a tile, marking it as the most recently used.
+   * @param tile_index the index of the tile in row-major order
+   * @return the tile, or nullptr if not cached
+   */
+  [[nodiscard]] std::shared_ptr<const DecodedTile> find(std::int32_t tile_index);
+
+  /**
+   * Insert a tile as the most recently used, evicting the least recently used tiles beyond the byte budget.
+   * If the tile is already cached, e.g. decoded concurrently, the cached tile is kept.
+   * @param tile_index the index of the tile in row-major order
+   * @param tile the decoded tile
+   * @return the cached tile
+   */
+  std::shared_ptr<const DecodedTile> insert(std::int32_t tile_index, std::shared_ptr<const DecodedTile> tile);
+
+  /**
+   * @return the amount of decoded bytes currently cached
+   */
+  [[nodiscard]] std::size_t byteCount() const;
+
+ private:
+  using entry_t = std::pair<std::int32_t, std::shared_ptr<const DecodedTile>>;
+
+  const std::size_t max_byte_count_;
+  std::size_t byte_count_{0};
+  std::list<entry_t> entries_{};  // The most recently used first
+  std::unordered_map<std::int32_t, std::list<entry_t>::iterator> entry_by_tile_index_{};
+  mutable std::mutex mutex_{};
+};
+
+TileCache::TileCache(const std::size_t max_byte_count) : max_byte_count_{max_byte_count} {}
+
+std::shared_ptr<const DecodedTile> TileCache::find(const std::int32_t tile_index) {
+  std::lock_guard lock{mutex_};
+  const auto it = entry_by_tile_index_.find(tile_index);
+  if (it == entry_by_tile_index_.end()) {
+    return nullptr;
+  }
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->second;
+}
+
+std::shared_ptr<const DecodedTile> TileCache::insert(const std::int32_t tile_index,
+                                                     std::shared_ptr<const DecodedTile> tile) {
+  const std::size_t tile_byte_count = tile->bytes.size();
+  std::lock_guard lock{mutex_};
+  if (const auto it = entry_by_tile_index_.find(tile_index); it != entry_by_tile_index_.end()) {
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->second;
+  }
+  if (max_byte_count_ < tile_byte_count) {
+    return tile;
+  }
+  while (max_byte_count_ - tile_byte_count < byte_count_) {
+    byte_count_ -= entries_.back().second->bytes.size();
+    entry_by_tile_index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  byte_count_ += tile_byte_count;
+  entries_.emplace_front(tile_index, tile);
+  entry_by_tile_index_.emplace(tile_index, entries_.begin());
+  return tile;
+}
+
+std::size_t TileCache::byteCount() const {
+  std::lock_guard lock{mutex_};
+  return byte_count_;
+}
+
+}  // namespace qct::image
@@ -21,12 +21,14 @@ using ImageTileDecoder = std::variant<HuffmanImageTileDecoder, PixelPackingImage
  * Make an image tile decoder for the given encoding and palette.
  * @param encoding the encoding of the image tile
  * @param palette the palette of the image tile
+ * @param code_book_cache the cache to share Huffman code books between tiles through, if any
  * @return an image tile decoder for the given encoding and palette
  */
-ImageTileDecoder makeImageTileDecoder(const ImageTile::Encoding encoding, const palette::Palette& palette) {
+ImageTileDecoder makeImageTileDecoder(const ImageTile::Encoding encoding, const palette::Palette& palette,
+                                      HuffmanCodeBookCache* code_book_cache = nullptr) {
   switch (encoding) {
     case ImageTile::Encoding::HUFFMAN_CODING:
-      return HuffmanImageTileDecoder{palette};
+      return HuffmanImageTileDecoder{palette, code_book_cache};
     case ImageTile::Encoding::PIXEL_PACKING:
       return PixelPackingImageTileDecoder{palette};
     case ImageTile::Encoding::RUN_LENGTH_ENCODING:
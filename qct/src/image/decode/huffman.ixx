@@ -1,9 +1,15 @@
 module;
 
-#include <complex>
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <format>
-#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <shared_mutex>
+#include <span>
+#include <unordered_map>
 #include <vector>
 
 export module qct:image.decode.huffman;
@@ -12,44 +18,150 @@ import :common.alias;
 import :common.exception;
 import :image.decoder;
 import :image.tile;
+import :image.writer;
 import :palette;
 import :palette.color;
 import :util.buffer;
-import :util.reader;
 
 export namespace qct::image::decode {
 /**
- * Huffman code book.
+ * Huffman code book, flattened into an array of nodes in preorder, the root being the first node.
  */
 class HuffmanCodeBook {
  public:
-  [[nodiscard]] bool isColor() const;
-  [[nodiscard]] bool isColor(std::int32_t node) const;
+  static constexpr std::int32_t MAX_NODE_COUNT{65536};
 
-  [[nodiscard]] bool isFarBranch() const;
-  [[nodiscard]] bool isFarBranch(std::int32_t node) const;
+  /**
+   * A node of the code book, either a branch node with resolved children or a color node with its palette index.
+   */
+  struct Node final {
+    std::array<std::uint16_t, 2> children{};  // Left (bit 0) and right (bit 1) child of a branch node
+    std::uint8_t palette_index{0};
+    bool is_color{false};
+  };
+
+  [[nodiscard]] std::int32_t size() const { return static_cast<std::int32_t>(nodes_.size()); }
+
+  [[nodiscard]] const Node& node(const std::int32_t index) const { return nodes_[index]; }
+
+  [[nodiscard]] std::size_t byteCount() const { return nodes_.size() * sizeof(Node); }
+
+  /**
+   * Read the encoded code book, which ends once there is one more color node than there are branch nodes.
+   * @param byte_buffer the buffer to read the code book from
+   * @return view of the encoded code book
+   * @throws QctException if the code book is truncated
+   */
+  static std::span<const std::uint8_t> readBytes(util::ByteBuffer& byte_buffer);
+
+  /**
+   * Parse the encoded code book and resolve its children.
+   * @param bytes the encoded code book
+   * @return the parsed code book
+   * @throws QctException if the code book is invalid
+   */
+  static HuffmanCodeBook parse(std::span<const std::uint8_t> bytes);
+
+ private:
+  std::vector<Node> nodes_{};
 
-  [[nodiscard]] bool isNearBranch() const;
-  [[nodiscard]] bool isNearBranch(std::int32_t node) const;
+  [[nodiscard]] static bool isColor(const std::uint8_t byte) { return byte < 128; }
+  [[nodiscard]] static bool isFarBranch(const std::uint8_t byte) { return byte == 128; }
+};
 
-  [[nodiscard]] bool isValid() const;
+/**
+ * A lookup table compiled from a Huffman code book, resolving the next bits of the bitstream with a single probe.
+ * Codes longer than the table resolve to the branch node reached after all bits of the table, from which decoding
+ * continues bit by bit.
+ */
+class HuffmanLookupTable {
+ public:
+  static constexpr std::int32_t MAX_BIT_COUNT{10};
 
-  [[nodiscard]] palette::Color getColor(const palette::Palette& palette) const;
-  [[nodiscard]] palette::Color getColor(const palette::Palette& palette, std::int32_t node) const;
+  struct Entry final {
+    std::uint16_t node{0};
+    std::uint8_t code_length{0};
+  };
 
-  [[nodiscard]] std::int32_t size() const;
+  explicit HuffmanLookupTable(const HuffmanCodeBook& code_book);
 
-  void resetPointer();
-  void step(bool bit);
+  [[nodiscard]] std::int32_t bitCount() const { return bit_count_; }
 
-  static HuffmanCodeBook parse(util::DynamicByteBuffer& dynamic_byte_buffer);
+  [[nodiscard]] std::size_t byteCount() const { return entries_.size() * sizeof(Entry); }
+
+  /**
+   * @param bits the next bitCount() bits of the bitstream, the first bit in the least significant bit
+   * @return the entry for the bits
+   */
+  [[nodiscard]] const Entry& lookup(const std::uint64_t bits) const { return entries_[bits]; }
 
  private:
-  std::vector<std::uint8_t> bytes_{};
-  std::int32_t pointer_{0};
+  std::int32_t bit_count_{0};
+  std::vector<Entry> entries_{};
+
+  void fill(const HuffmanCodeBook& code_book, std::int32_t node, std::uint32_t code, std::int32_t code_length);
+};
+
+/**
+ * A Huffman code book along with its lookup table, ready for decoding.
+ */
+struct CompiledHuffmanCodeBook final {
+  HuffmanCodeBook code_book;
+  HuffmanLookupTable lookup_table;
+
+  explicit CompiledHuffmanCodeBook(HuffmanCodeBook code_book)
+      : code_book{std::move(code_book)}, lookup_table{this->code_book} {}
 
-  [[nodiscard]] std::int32_t farBranchJumpSize(std::int32_t node) const;
-  [[nodiscard]] std::int32_t nearBranchJumpSize(std::int32_t node) const;
+  [[nodiscard]] std::size_t byteCount() const { return code_book.byteCount() + lookup_table.byteCount(); }
+};
+
+/**
+ * A thread-safe cache of compiled Huffman code books of a single QCT-file, keyed by a hash of the encoded code book.
+ * Charts repeat the same code books across many tiles (sea, margins, forest), which are then parsed and compiled once.
+ */
+class HuffmanCodeBookCache final {
+ public:
+  static constexpr std::size_t DEFAULT_MAX_BYTE_COUNT{16 << 20};
+
+  /**
+   * @param max_byte_count the byte budget of the encoded and compiled code books, 0 to disable caching
+   */
+  explicit HuffmanCodeBookCache(const std::size_t max_byte_count = DEFAULT_MAX_BYTE_COUNT)
+      : max_byte_count_{max_byte_count} {}
+
+  /**
+   * Get the compiled code book, compiling and caching it if not cached yet. Once the byte budget is spent, no more code
+   * books are cached.
+   * @param code_book_bytes the encoded code book
+   * @return the compiled code book
+   * @throws QctException if the code book is invalid
+   */
+  [[nodiscard]] std::shared_ptr<const CompiledHuffmanCodeBook> get(std::span<const std::uint8_t> code_book_bytes);
+
+  /**
+   * @return the amount of bytes of the currently cached code books
+   */
+  [[nodiscard]] std::size_t byteCount() const;
+
+ private:
+  struct Entry final {
+    std::vector<std::uint8_t> code_book_bytes;
+    std::shared_ptr<const CompiledHuffmanCodeBook> compiled_code_book;
+  };
+
+  const std::size_t max_byte_count_;
+  std::size_t byte_count_{0};
+  mutable std::shared_mutex mutex_{};
+  std::unordered_multimap<std::uint64_t, Entry> entries_{};
+
+  /**
+   * @param bytes to hash
+   * @return the 64-bit FNV-1a hash of the bytes
+   */
+  [[nodiscard]] static std::uint64_t hash(std::span<const std::uint8_t> bytes);
+
+  [[nodiscard]] std::shared_ptr<const CompiledHuffmanCodeBook> find(
+      std::uint64_t key, std::span<const std::uint8_t> code_book_bytes) const;
 };
 
 /**
@@ -57,174 +169,189 @@ class HuffmanCodeBook {
  */
 class HuffmanImageTileDecoder final : public AbstractImageTileDecoder<HuffmanImageTileDecoder> {
  public:
-  explicit HuffmanImageTileDecoder(const palette::Palette& palette) : AbstractImageTileDecoder{palette} {}
+  /**
+   * @param palette the palette to resolve the colors with
+   * @param code_book_cache the cache to share the compiled code books through, or none to compile every code book
+   */
+  explicit HuffmanImageTileDecoder(const palette::Palette& palette, HuffmanCodeBookCache* code_book_cache = nullptr)
+      : AbstractImageTileDecoder{palette}, code_book_cache_{code_book_cache} {}
   ~HuffmanImageTileDecoder() override = default;
 
   /**
    * Decode bytes of an image tile using Huffman Coding.
-   * @param file to read from
-   * @param image_tile_byte_offset the byte offset of the tile in the image file
-   * @return the tile bytes
+   * @param tile_bytes the compressed bytes of the tile
+   * @param tile_writer to write the pixels with
    */
-  [[nodiscard]] ImageTile::bytes_2d_t decodeTileBytes(std::ifstream& file, byte_offset_t image_tile_byte_offset) const;
-};
-
-bool HuffmanCodeBook::isColor() const {
-  return isColor(pointer_);
-}
+  void decodeTileBytes(std::span<const std::uint8_t> tile_bytes, TileWriter& tile_writer) const;
 
-bool HuffmanCodeBook::isColor(const std::int32_t node) const {
-  return static_cast<std::int32_t>(bytes_[node]) < 128;
-}
-bool HuffmanCodeBook::isFarBranch() const {
-  return isFarBranch(pointer_);
-}
+ private:
+  HuffmanCodeBookCache* code_book_cache_;
+};
 
-bool HuffmanCodeBook::isFarBranch(const std::int32_t node) const {
-  return static_cast<std::int32_t>(bytes_[node]) == 128;
+std::span<const std::uint8_t> HuffmanCodeBook::readBytes(util::ByteBuffer& byte_buffer) {
+  const std::span<const std::uint8_t> bytes = byte_buffer.remainingBytes();
+  // A color or near branch node is encoded in a single byte, a far branch node in three bytes
+  std::int32_t color_count{0};
+  std::int32_t branch_count{0};
+  while (color_count <= branch_count) {
+    const std::uint8_t byte = byte_buffer.nextByte();
+    if (isFarBranch(byte)) {
+      static_cast<void>(byte_buffer.nextByte());
+      static_cast<void>(byte_buffer.nextByte());
+      ++branch_count;
+    } else if (isColor(byte)) {
+      ++color_count;
+    } else {
+      ++branch_count;
+    }
+  }
+  return bytes.first(bytes.size() - byte_buffer.remainingBytes().size());
 }
 
-bool HuffmanCodeBook::isNearBranch() const {
-  return isNearBranch(pointer_);
+HuffmanCodeBook HuffmanCodeBook::parse(const std::span<const std::uint8_t> bytes) {
+  std::vector<std::int32_t> node_byte_offsets{};
+  node_byte_offsets.reserve(256);
+  std::size_t next_byte_offset{0};
+  while (next_byte_offset < bytes.size()) {
+    node_byte_offsets.push_back(static_cast<std::int32_t>(next_byte_offset));
+    next_byte_offset += isFarBranch(bytes[next_byte_offset]) ? 3 : 1;
+  }
+  // The last node must not be a truncated far branch node
+  if (node_byte_offsets.empty() || node_byte_offsets.size() > MAX_NODE_COUNT || next_byte_offset != bytes.size()) {
+    throw QctException{"Invalid Huffman tree"};
+  }
+  // Jumps are encoded as byte distances, translate them into node indices
+  std::vector<std::int32_t> node_indices(bytes.size(), -1);
+  for (std::size_t i = 0; i < node_byte_offsets.size(); ++i) {
+    node_indices[node_byte_offsets[i]] = static_cast<std::int32_t>(i);
+  }
+  const auto node_index_at = [&](const std::int32_t byte_offset) {
+    if (byte_offset >= static_cast<std::int32_t>(bytes.size()) || node_indices[byte_offset] < 0) {
+      throw QctException{"Invalid Huffman tree"};
+    }
+    return static_cast<std::uint16_t>(node_indices[byte_offset]);
+  };
+  HuffmanCodeBook tree{};
+  tree.nodes_.resize(node_byte_offsets.size());
+  for (std::size_t i = 0; i < node_byte_offsets.size(); ++i) {
+    const std::int32_t byte_offset = node_byte_offsets[i];
+    const std::uint8_t byte = bytes[byte_offset];
+    Node& node = tree.nodes_[i];
+    if (isColor(byte)) {
+      node = {.palette_index = byte, .is_color = true};
+    } else if (isFarBranch(byte)) {
+      const std::int32_t jump = 65537 - (256 * bytes[byte_offset + 2] + bytes[byte_offset + 1]) + 2;
+      node.children = {node_index_at(byte_offset + 3), node_index_at(byte_offset + jump)};
+    } else {  // Near branch
+      const std::int32_t jump = 257 - byte;
+      node.children = {node_index_at(byte_offset + 1), node_index_at(byte_offset + jump)};
+    }
+  }
+  return tree;
 }
 
-bool HuffmanCodeBook::isNearBranch(const std::int32_t node) const {
-  return static_cast<std::int32_t>(bytes_[node]) > 128;
+HuffmanLookupTable::HuffmanLookupTable(const HuffmanCodeBook& code_book) {
+  // A code is at most as long as there are branches, so small code books get small tables
+  const auto branch_count = std::ranges::count_if(std::views::iota(0, code_book.size()),
+                                                  [&](const std::int32_t i) { return !code_book.node(i).is_color; });
+  bit_count_ = static_cast<std::int32_t>(std::min<std::ptrdiff_t>(branch_count, MAX_BIT_COUNT));
+  entries_.resize(std::size_t{1} << bit_count_);
+  fill(code_book, 0, 0, 0);
 }
 
-bool HuffmanCodeBook::isValid() const {
-  if (size() == 0)
-    return false;
-  if (size() == 1)
-    return true;
-  for (std::int32_t i = 0; i < size(); ++i) {
-    if (isColor(i))
-      continue;
-    if (isFarBranch(i)) {
-      if (i + 2 >= size())
-        return false;
-      if (i + farBranchJumpSize(i) >= size())
-        return false;
-      i += 2;
-    } else if (isNearBranch(i)) {
-      if (i + nearBranchJumpSize(i) >= size())
-        return false;
-    } else {
-      return false;
+void HuffmanLookupTable::fill(const HuffmanCodeBook& code_book, const std::int32_t node, const std::uint32_t code,
+                              const std::int32_t code_length) {
+  const HuffmanCodeBook::Node& code_book_node = code_book.node(node);
+  if (code_book_node.is_color || code_length == bit_count_) {
+    // All entries whose lowest bits equal the code, regardless of the bits following it
+    const Entry entry{.node = static_cast<std::uint16_t>(node), .code_length = static_cast<std::uint8_t>(code_length)};
+    for (std::uint32_t suffix = 0; suffix < std::uint32_t{1} << (bit_count_ - code_length); ++suffix) {
+      entries_[code | suffix << code_length] = entry;
     }
+    return;
   }
-  return true;
+  fill(code_book, code_book_node.children[0], code, code_length + 1);
+  fill(code_book, code_book_node.children[1], code | std::uint32_t{1} << code_length, code_length + 1);
 }
 
-palette::Color HuffmanCodeBook::getColor(const palette::Palette& palette) const {
-  return getColor(palette, pointer_);
-}
-palette::Color HuffmanCodeBook::getColor(const palette::Palette& palette, const std::int32_t node) const {
-  if (!isColor(node))
-    throw QctException{std::format("Attempting to get color from non-color node={}", node)};
-  return palette.colors[static_cast<std::int32_t>(bytes_[node])];
-}
-
-std::int32_t HuffmanCodeBook::size() const {
-  return static_cast<std::int32_t>(bytes_.size());
+std::shared_ptr<const CompiledHuffmanCodeBook> HuffmanCodeBookCache::get(
+    const std::span<const std::uint8_t> code_book_bytes) {
+  const std::uint64_t key = hash(code_book_bytes);
+  {
+    std::shared_lock lock{mutex_};
+    if (auto compiled_code_book = find(key, code_book_bytes)) {
+      return compiled_code_book;
+    }
+  }
+  // Compile without holding the lock, another thread may compile the same code book meanwhile
+  auto compiled_code_book =
+      std::make_shared<const CompiledHuffmanCodeBook>(HuffmanCodeBook::parse(code_book_bytes));
+  std::unique_lock lock{mutex_};
+  if (auto cached_code_book = find(key, code_book_bytes)) {
+    return cached_code_book;
+  }
+  const std::size_t entry_byte_count = code_book_bytes.size() + compiled_code_book->byteCount();
+  if (entry_byte_count <= max_byte_count_ - byte_count_) {
+    entries_.emplace(key, Entry{.code_book_bytes = {code_book_bytes.begin(), code_book_bytes.end()},
+                                .compiled_code_book = compiled_code_book});
+    byte_count_ += entry_byte_count;
+  }
+  return compiled_code_book;
 }
 
-void HuffmanCodeBook::resetPointer() {
-  pointer_ = 0;
+std::size_t HuffmanCodeBookCache::byteCount() const {
+  std::shared_lock lock{mutex_};
+  return byte_count_;
 }
 
-void HuffmanCodeBook::step(const bool bit) {
-  if (bit) {  // Right, i.e. jump
-    if (isNearBranch(pointer_)) {
-      pointer_ += nearBranchJumpSize(pointer_);
-    } else if (isFarBranch()) {
-      pointer_ += farBranchJumpSize(pointer_);
-    } else {
-      throw QctException{"Attempting to step in a non-branch node"};
-    }
-  } else {  // Left, i.e. no jump
-    if (isFarBranch(pointer_)) {
-      pointer_ += 3;
-    } else if (isNearBranch(pointer_)) {
-      ++pointer_;
-    } else {
-      throw QctException{"Attempting to step in a non-branch node"};
-    }
+std::uint64_t HuffmanCodeBookCache::hash(const std::span<const std::uint8_t> bytes) {
+  std::uint64_t hash{0xcbf29ce484222325};
+  for (const std::uint8_t byte : bytes) {
+    hash = (hash ^ byte) * 0x100000001b3;
   }
+  return hash;
 }
 
-HuffmanCodeBook HuffmanCodeBook::parse(util::DynamicByteBuffer& dynamic_byte_buffer) {
-  HuffmanCodeBook tree{};
-  tree.bytes_.reserve(256);
-  std::int32_t color_count{0};
-  std::int32_t branch_count{0};
-  while (color_count <= branch_count) {
-    tree.bytes_.push_back(dynamic_byte_buffer.nextByte());
-    if (tree.isFarBranch(tree.size() - 1)) {
-      tree.bytes_.push_back(dynamic_byte_buffer.nextByte());
-      tree.bytes_.push_back(dynamic_byte_buffer.nextByte());
-      ++branch_count;
-    } else if (tree.isNearBranch(tree.size() - 1)) {
-      ++branch_count;
-    } else {
-      ++color_count;
+std::shared_ptr<const CompiledHuffmanCodeBook> HuffmanCodeBookCache::find(
+    const std::uint64_t key, const std::span<const std::uint8_t> code_book_bytes) const {
+  const auto [begin, end] = entries_.equal_range(key);
+  for (auto it = begin; it != end; ++it) {
+    if (std::ranges::equal(it->second.code_book_bytes, code_book_bytes)) {
+      return it->second.compiled_code_book;
     }
   }
-  if (!tree.isValid()) {
-    throw QctException{"Invalid Huffman tree"};
-  }
-  return tree;
+  return nullptr;
 }
 
-std::int32_t HuffmanCodeBook::farBranchJumpSize(const std::int32_t node) const {
-  return 65537 - (256 * static_cast<std::int32_t>(bytes_[node + 2]) + static_cast<std::int32_t>(bytes_[node + 1])) + 2;
-}
-std::int32_t HuffmanCodeBook::nearBranchJumpSize(const std::int32_t node) const {
-  return 257 - static_cast<std::int32_t>(bytes_[node]);
-}
-ImageTile::bytes_2d_t HuffmanImageTileDecoder::decodeTileBytes(std::ifstream& file,
-                                                               const byte_offset_t image_tile_byte_offset) const {
-  ImageTile::bytes_2d_t tile{};
-  util::DynamicByteBuffer dynamic_byte_buffer{file, image_tile_byte_offset + 1, 4096};
-  auto tree = HuffmanCodeBook::parse(dynamic_byte_buffer);
+void HuffmanImageTileDecoder::decodeTileBytes(const std::span<const std::uint8_t> tile_bytes,
+                                              TileWriter& tile_writer) const {
+  util::ByteBuffer byte_buffer{tile_bytes.subspan(std::min<std::size_t>(1, tile_bytes.size()))};
+  const std::span<const std::uint8_t> code_book_bytes = HuffmanCodeBook::readBytes(byte_buffer);
+  const std::shared_ptr<const CompiledHuffmanCodeBook> compiled_code_book =
+      code_book_cache_ != nullptr
+          ? code_book_cache_->get(code_book_bytes)
+          : std::make_shared<const CompiledHuffmanCodeBook>(HuffmanCodeBook::parse(code_book_bytes));
+  const HuffmanCodeBook& tree = compiled_code_book->code_book;
   if (tree.size() == 1) {
-    const auto [red, green, blue] = tree.getColor(palette, 0);
-    for (std::int32_t pixel_index = 0; pixel_index < ImageTile::PIXEL_COUNT; ++pixel_index) {
-      const std::int32_t y = pixel_index * palette::COLOR_CHANNELS / ImageTile::ROW_BYTE_COUNT;
-      const std::int32_t x = pixel_index * palette::COLOR_CHANNELS % ImageTile::ROW_BYTE_COUNT;
-      tile[y][x + 0] = red;
-      tile[y][x + 1] = green;
-      tile[y][x + 2] = blue;
-    }
-    return tile;
+    tile_writer.writeRun(tree.node(0).palette_index, ImageTile::PIXEL_COUNT);
+    return;
   }
-  std::uint8_t current_byte = dynamic_byte_buffer.nextByte();
-  std::int32_t bit_count{8};
-  std::int32_t pixel_index{0};
-  tree.resetPointer();
-  while (pixel_index < ImageTile::PIXEL_COUNT) {
-    if (tree.isColor()) {
-      const std::int32_t y = pixel_index * palette::COLOR_CHANNELS / ImageTile::ROW_BYTE_COUNT;
-      const std::int32_t x = pixel_index * palette::COLOR_CHANNELS % ImageTile::ROW_BYTE_COUNT;
-      const auto [red, green, blue] = tree.getColor(palette);
-      tile[y][x + 0] = red;
-      tile[y][x + 1] = green;
-      tile[y][x + 2] = blue;
-      ++pixel_index;
-      tree.resetPointer();
-      continue;
-    }
-    const bool bit = current_byte & 1;
-    tree.step(bit);
-
-    current_byte >>= 1;
-    --bit_count;
-    if (bit_count == 0) {
-      current_byte = dynamic_byte_buffer.nextByte();
-      bit_count = 8;
+  const HuffmanLookupTable& lookup_table = compiled_code_book->lookup_table;
+  util::BitBuffer bit_buffer{byte_buffer.remainingBytes()};
+  for (std::int32_t pixel_index = 0; pixel_index < ImageTile::PIXEL_COUNT; ++pixel_index) {
+    bit_buffer.refill();
+    const HuffmanLookupTable::Entry& entry = lookup_table.lookup(bit_buffer.peek(lookup_table.bitCount()));
+    bit_buffer.consume(entry.code_length);
+    const HuffmanCodeBook::Node* node = &tree.node(entry.node);
+    while (!node->is_color) {  // Codes longer than the lookup table
+      node = &tree.node(node->children[bit_buffer.nextBit()]);
     }
+    tile_writer.writePixel(node->palette_index);
+  }
+  // Bits past the end of the tile read as zeros, whether any of them were needed is checked once at the end
+  if (bit_buffer.exhausted()) {
+    throw QctException{"Huffman tile ended before all pixels were decoded"};
   }
-  return tile;
 }
 
 }  // namespace qct::image::decode
@@ -1,16 +1,16 @@
 module;
 
 #include <algorithm>
-#include <cmath>
+#include <bit>
 #include <cstdint>
-#include <fstream>
+#include <span>
 #include <stdexcept>
 #include <vector>
 
 export module qct:image.decode.palette;
 
 import :common.alias;
-import :util.reader;
+import :common.exception;
 
 export namespace qct::image::decode {
 /**
@@ -26,26 +26,39 @@ struct SubPalette final {
   std::vector<std::int32_t> palette_indices{};
 
   [[nodiscard]] std::int32_t bitsRequiredToIndex() const {
-    return static_cast<std::int32_t>(std::ceil(std::log2(size)));
+    return size <= 1 ? 0 : static_cast<std::int32_t>(std::bit_width(static_cast<std::uint32_t>(size - 1)));
   }
 
-  static SubPalette parse(std::ifstream& file, byte_offset_t byte_offset, SizeType size_type);
+  /**
+   * Parse the sub-palette from the start of the compressed bytes of a tile.
+   * @param tile_bytes the compressed bytes of the tile
+   * @param size_type how the size of the sub-palette is stored
+   * @return the parsed sub-palette
+   * @throws QctException if the tile is too short for its sub-palette
+   */
+  static SubPalette parse(std::span<const std::uint8_t> tile_bytes, SizeType size_type);
 };
 
-SubPalette SubPalette::parse(std::ifstream& file, const byte_offset_t byte_offset, const SizeType size_type) {
+SubPalette SubPalette::parse(const std::span<const std::uint8_t> tile_bytes, const SizeType size_type) {
+  if (tile_bytes.empty()) {
+    throw QctException{"Tile too short for its sub-palette"};
+  }
   std::int32_t size{};
   switch (size_type) {
     case SizeType::NORMAL: {
-      size = static_cast<std::int32_t>(util::readByte(file, byte_offset));
+      size = static_cast<std::int32_t>(tile_bytes[0]);
     } break;
     case SizeType::INVERSE: {
-      size = 256 - static_cast<std::int32_t>(util::readByte(file, byte_offset));
+      size = 256 - static_cast<std::int32_t>(tile_bytes[0]);
     } break;
     default:
       throw std::logic_error{"qct::image::decode::SubPalette::parse: unknown qct::image::decode::SubPalette::SizeType"};
   }
+  if (tile_bytes.size() < static_cast<std::size_t>(0x01 + size)) {
+    throw QctException{"Tile too short for its sub-palette"};
+  }
   std::vector palette_indices(size, 0);
-  const std::vector<std::uint8_t> bytes = util::readBytes(file, byte_offset + 0x01, size);
+  const std::span<const std::uint8_t> bytes = tile_bytes.subspan(0x01, size);
   std::ranges::transform(bytes, palette_indices.begin(),
                          [](const std::uint8_t byte) { return static_cast<std::int32_t>(byte); });
   return {.size = size, .palette_indices = palette_indices};
@@ -1,31 +1,29 @@
 module;
 
 #include <cstdint>
-#include <fstream>
-#include <iostream>
+#include <span>
 
 export module qct:image.decode.pp;
 
 import :common.alias;
 import :image.decoder;
 import :image.tile;
+import :image.writer;
 import :palette;
-import :util.reader;
 
 export namespace qct::image::decode {
 /**
- * A decoder for image tiles using Pixel Packing. NOTE: This decoder has not been implemented yet.
+ * A decoder for image tiles using Pixel Packing. NOTE: This decoder has not been implemented yet, it fills the tile
+ * with the first color of the palette, so that reused buffers never show stale pixels.
  */
 class PixelPackingImageTileDecoder final : public AbstractImageTileDecoder<PixelPackingImageTileDecoder> {
  public:
   explicit PixelPackingImageTileDecoder(const palette::Palette& palette) : AbstractImageTileDecoder{palette} {}
   ~PixelPackingImageTileDecoder() override = default;
 
-  [[nodiscard]] ImageTile::bytes_2d_t decodeTileBytes(std::ifstream& file,
-                                                      const byte_offset_t image_tile_byte_offset) const {
+  void decodeTileBytes(std::span<const std::uint8_t> tile_bytes, TileWriter& tile_writer) const {
     // TODO
-    std::cerr << "Pixel packing decoder not implemented, output tile shall be empty" << std::endl;
-    return {};
+    tile_writer.writeRun(0, ImageTile::PIXEL_COUNT);
   }
 };
 }  // namespace qct::image::decode
@@ -1,27 +1,36 @@
 module;
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
-#include <fstream>
+#include <span>
 
 export module qct:image.decode.rle;
 
 import :common.alias;
+import :common.exception;
 import :image.decoder;
 import :image.decode.palette;
 import :image.tile;
+import :image.writer;
 import :palette;
 import :palette.color;
-import :util.reader;
 
 namespace qct::image::decode {
 /**
  * A single decoded RLE byte.
  */
-struct DecodedRleByte {
-  std::int32_t palette_index{0};
-  std::int32_t run_length{0};
+struct DecodedRleByte final {
+  std::uint8_t palette_index{0};
+  std::uint8_t run_length{0};
+  bool is_valid{false};  // Whether the byte indexes a color of the sub-palette, and that one of the palette
 };
 
+/**
+ * The decoded RLE bytes of all possible byte values, for a given sub-palette.
+ */
+using RleLookupTable = std::array<DecodedRleByte, 256>;
+
 /**
  * A decoder for image tiles using Run Length Encoding (RLE).
  */
@@ -32,55 +41,56 @@ export class RLEImageTileDecoder final : public AbstractImageTileDecoder<RLEImag
 
   /**
    * Decode bytes of an image tile using Run Length Encoding (RLE).
-   * @param file to read from
-   * @param image_tile_byte_offset the byte offset of the tile in the image file
-   * @return the tile bytes
+   * @param tile_bytes the compressed bytes of the tile
+   * @param tile_writer to write the pixels with
    */
-  [[nodiscard]] ImageTile::bytes_2d_t decodeTileBytes(std::ifstream& file, byte_offset_t image_tile_byte_offset) const;
+  void decodeTileBytes(std::span<const std::uint8_t> tile_bytes, TileWriter& tile_writer) const;
 
  private:
   /**
-   * Decode a single RLE byte.
-   * @param[in] rle_byte the RLE byte to decode
-   * @param[in] sub_palette the sub-palette
-   * @return decoded RLE byte
+   * Decode every possible RLE byte once. The lower bits of an RLE byte index the sub-palette, the upper bits hold
+   * the run length.
+   * @param sub_palette the sub-palette of the tile
+   * @return the lookup table of decoded RLE bytes
    */
-  static DecodedRleByte decodeRleByte(std::uint8_t rle_byte, const SubPalette& sub_palette);
+  [[nodiscard]] RleLookupTable makeLookupTable(const SubPalette& sub_palette) const;
 };
 
-ImageTile::bytes_2d_t RLEImageTileDecoder::decodeTileBytes(std::ifstream& file,
-                                                           const byte_offset_t image_tile_byte_offset) const {
-  const auto sub_palette = SubPalette::parse(file, image_tile_byte_offset, SubPalette::SizeType::NORMAL);
-  const byte_offset_t pixel_data_byte_offset = image_tile_byte_offset + 0x01 + sub_palette.size;
-  ImageTile::bytes_2d_t tile{};
-  // In order to avoid reading one byte at a time from the file,
-  // read bytes into a buffer assuming the worst case of one byte per pixel,
-  // which practically should never occur (64 x 64 = 4096 bytes).
-  const std::vector<std::uint8_t> bytes = util::readBytesSafe(file, pixel_data_byte_offset, ImageTile::PIXEL_COUNT);
+void RLEImageTileDecoder::decodeTileBytes(const std::span<const std::uint8_t> tile_bytes,
+                                          TileWriter& tile_writer) const {
+  const auto sub_palette = SubPalette::parse(tile_bytes, SubPalette::SizeType::NORMAL);
+  const std::span<const std::uint8_t> bytes = tile_bytes.subspan(0x01 + sub_palette.size);
+  const RleLookupTable lookup_table = makeLookupTable(sub_palette);
   std::size_t byte_index{0};
-  std::int32_t pixel_count = 0;
-  while (pixel_count < ImageTile::PIXEL_COUNT) {
-    const std::uint8_t rle_byte = bytes[byte_index++];
-    const auto [palette_index, run_length] = decodeRleByte(rle_byte, sub_palette);
-    const auto [red, green, blue] = palette.colors[palette_index];
-    for (std::int32_t i = 0; i < run_length; ++i) {
-      const std::int32_t y = (pixel_count + i) * palette::COLOR_CHANNELS / ImageTile::ROW_BYTE_COUNT;
-      const std::int32_t x = (pixel_count + i) * palette::COLOR_CHANNELS % ImageTile::ROW_BYTE_COUNT;
-      tile[y][x + 0] = red;
-      tile[y][x + 1] = green;
-      tile[y][x + 2] = blue;
+  while (!tile_writer.full()) {
+    if (byte_index == bytes.size()) {
+      throw QctException{"RLE tile ended before all pixels were decoded"};
+    }
+    const auto [palette_index, run_length, is_valid] = lookup_table[bytes[byte_index++]];
+    if (!is_valid) {
+      throw QctException{"RLE byte references a color outside the (sub-)palette"};
     }
-    pixel_count += run_length;
+    tile_writer.writeRun(palette_index, run_length);
   }
-  return tile;
 }
 
-DecodedRleByte RLEImageTileDecoder::decodeRleByte(const std::uint8_t rle_byte, const SubPalette& sub_palette) {
-  const std::uint32_t sub_palette_index_mask = (1 << static_cast<std::uint32_t>(sub_palette.bitsRequiredToIndex())) - 1;
-  const std::uint32_t sub_palette_index = rle_byte & sub_palette_index_mask;
-  const std::uint32_t run_length = rle_byte >> sub_palette.bitsRequiredToIndex();
-  return {.palette_index = sub_palette.palette_indices[sub_palette_index],
-          .run_length = static_cast<std::int32_t>(run_length)};
+RleLookupTable RLEImageTileDecoder::makeLookupTable(const SubPalette& sub_palette) const {
+  const std::int32_t index_bit_count = sub_palette.bitsRequiredToIndex();
+  const std::uint32_t sub_palette_index_mask = (1u << index_bit_count) - 1;
+  RleLookupTable lookup_table{};
+  for (std::uint32_t rle_byte = 0; rle_byte < lookup_table.size(); ++rle_byte) {
+    const std::uint32_t sub_palette_index = rle_byte & sub_palette_index_mask;
+    if (sub_palette_index >= static_cast<std::uint32_t>(sub_palette.size)) {
+      continue;
+    }
+    const std::int32_t palette_index = sub_palette.palette_indices[sub_palette_index];
+    if (palette_index < palette::Palette::COLOR_COUNT) {
+      lookup_table[rle_byte] = {.palette_index = static_cast<std::uint8_t>(palette_index),
+                                .run_length = static_cast<std::uint8_t>(rle_byte >> index_bit_count),
+                                .is_valid = true};
+    }
+  }
+  return lookup_table;
 }
 
 }  // namespace qct::image::decode
@@ -0,0 +1,151 @@
+module;
+
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <numeric>
+#include <span>
+#include <utility>
+#include <vector>
+
+export module qct:image.directory;
+
+import :common.alias;
+import :common.exception;
+import :image.tile;
+import :util.file_source;
+
+export namespace qct::image {
+/**
+ * The exact location and encoding of the compressed bytes of an image tile.
+ */
+struct TileExtent final {
+  byte_offset_t byte_offset{0};
+  byte_offset_t byte_count{0};
+  ImageTile::Encoding encoding{};
+};
+
+/**
+ * A contiguous byte range of the file covering the compressed bytes of one or more image tiles.
+ */
+struct TileReadBatch final {
+  byte_offset_t byte_offset{0};
+  byte_offset_t byte_count{0};
+  std::vector<std::int32_t> tile_indices{};
+};
+
+/**
+ * A directory of the compressed byte ranges of all image tiles, built from the image tile pointers.
+ * The tiles are stored back-to-back, so a tile ends where the tile with the next larger byte offset begins,
+ * and the last tile in the file ends at EOF.
+ */
+struct TileDirectory final {
+  std::int32_t width_tiles{0};
+  std::int32_t height_tiles{0};
+  std::vector<TileExtent> extents{};
+
+  [[nodiscard]] std::int32_t tileCount() const { return width_tiles * height_tiles; }
+
+  [[nodiscard]] const TileExtent& extent(const std::int32_t y_tile, const std::int32_t x_tile) const {
+    return extents[y_tile * width_tiles + x_tile];
+  }
+
+  /**
+   * Coalesce the image tiles into contiguous byte ranges in ascending file offset order.
+   * A batch is closed when adding the next tile would exceed the given byte count, or when there is a gap between
+   * the tiles. Tiles sharing an extent are placed in the same batch.
+   * @param max_byte_count the maximum byte count of a batch, unless a single tile is larger
+   * @return the read batches in ascending file offset order
+   */
+  [[nodiscard]] std::vector<TileReadBatch> readBatches(const byte_offset_t max_byte_count) const {
+    return readBatches(max_byte_count, 0, tileCount());
+  }
+
+  /**
+   * Coalesce a range of image tiles in row-major order, e.g. a band of the image, into read batches.
+   * @param max_byte_count the maximum byte count of a batch, unless a single tile is larger
+   * @param first_tile_index the row-major index of the first tile of the range
+   * @param tile_count the amount of tiles of the range
+   * @return the read batches in ascending file offset order
+   */
+  [[nodiscard]] std::vector<TileReadBatch> readBatches(byte_offset_t max_byte_count, std::int32_t first_tile_index,
+                                                       std::int32_t tile_count) const;
+
+  /**
+   * Build the tile directory.
+   * @param file the QCT-file
+   * @param width_tiles width of the image in tiles
+   * @param height_tiles height of the image in tiles
+   * @param image_tile_pointers the pointers (byte offsets) of the image tiles in row-major order
+   * @param tile_data_byte_offset the smallest byte offset an image tile may be located at
+   * @return the tile directory
+   * @throws QctException if any of the pointers is outside the tile data of the file
+   */
+  static TileDirectory build(const util::FileSource& file, std::int32_t width_tiles, std::int32_t height_tiles,
+                             std::span<const std::uint32_t> image_tile_pointers, byte_offset_t tile_data_byte_offset);
+};
+
+std::vector<TileReadBatch> TileDirectory::readBatches(const byte_offset_t max_byte_count,
+                                                      const std::int32_t first_tile_index,
+                                                      const std::int32_t tile_count) const {
+  std::vector<std::int32_t> tiles_by_offset(tile_count);
+  std::iota(tiles_by_offset.begin(), tiles_by_offset.end(), first_tile_index);
+  std::ranges::sort(tiles_by_offset, {}, [this](const std::int32_t i) { return extents[i].byte_offset; });
+  std::vector<TileReadBatch> read_batches{};
+  for (const std::int32_t tile_index : tiles_by_offset) {
+    const TileExtent& tile_extent = extents[tile_index];
+    if (!read_batches.empty()) {
+      TileReadBatch& read_batch = read_batches.back();
+      const byte_offset_t read_batch_end = read_batch.byte_offset + read_batch.byte_count;
+      if (tile_extent.byte_offset < read_batch_end) {  // Shared extent
+        read_batch.tile_indices.push_back(tile_index);
+        continue;
+      }
+      const bool fits = read_batch.byte_count + tile_extent.byte_count <= max_byte_count;
+      if (tile_extent.byte_offset == read_batch_end && fits) {
+        read_batch.byte_count += tile_extent.byte_count;
+        read_batch.tile_indices.push_back(tile_index);
+        continue;
+      }
+    }
+    read_batches.push_back(
+        {.byte_offset = tile_extent.byte_offset, .byte_count = tile_extent.byte_count, .tile_indices = {tile_index}});
+  }
+  return read_batches;
+}
+
+TileDirectory TileDirectory::build(const util::FileSource& file, const std::int32_t width_tiles,
+                                   const std::int32_t height_tiles,
+                                   const std::span<const std::uint32_t> image_tile_pointers,
+                                   const byte_offset_t tile_data_byte_offset) {
+  const auto tile_count = static_cast<std::int32_t>(image_tile_pointers.size());
+  if (tile_count != width_tiles * height_tiles) {
+    throw QctException{std::format("Expected {} image tile pointers, got {}", width_tiles * height_tiles, tile_count)};
+  }
+  for (std::int32_t i = 0; i < tile_count; ++i) {
+    if (image_tile_pointers[i] < tile_data_byte_offset || file.size() <= image_tile_pointers[i]) {
+      throw QctException{
+          std::format("Image tile pointer of tile={} out of range, offset={}", i, image_tile_pointers[i])};
+    }
+  }
+  // Several tiles may share the same compressed bytes, they map to the same extent
+  std::vector<std::int32_t> tiles_by_offset(tile_count);
+  std::iota(tiles_by_offset.begin(), tiles_by_offset.end(), 0);
+  std::ranges::sort(tiles_by_offset, {}, [&](const std::int32_t i) { return image_tile_pointers[i]; });
+  std::vector<TileExtent> extents(tile_count);
+  byte_offset_t next_byte_offset = file.size();
+  for (auto it = tiles_by_offset.rbegin(); it != tiles_by_offset.rend(); ++it) {
+    const byte_offset_t byte_offset = image_tile_pointers[*it];
+    if (byte_offset < next_byte_offset) {
+      extents[*it] = {.byte_offset = byte_offset,
+                      .byte_count = next_byte_offset - byte_offset,
+                      .encoding = ImageTile::encodingOf(file, byte_offset)};
+      next_byte_offset = byte_offset;
+    } else {
+      extents[*it] = extents[*(it - 1)];
+    }
+  }
+  return {.width_tiles = width_tiles, .height_tiles = height_tiles, .extents = std::move(extents)};
+}
+
+}  // namespace qct::image
@@ -1,11 +1,15 @@
 module;
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
-#include <filesystem>
-#include <fstream>
+#include <deque>
+#include <format>
+#include <functional>
 #include <future>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <ranges>
 #include <span>
 #include <utility>
@@ -17,13 +21,73 @@ export module qct:image.index;
 import :common.alias;
 import :common.crtp;
 import :image.decode;
+import :image.decode.huffman;
+import :image.directory;
 import :image.tile;
+import :image.writer;
 import :meta;
 import :palette;
 import :palette.color;
+import :util.file_source;
 import :util.reader;
+import :util.thread_pool;
 
 export namespace qct::image {
+/**
+ * Options for decoding the image tiles.
+ */
+struct DecodeOptions final {
+  /**
+   * The order in which the image tiles are scheduled for decoding.
+   */
+  enum class Order {
+    ROW_MAJOR,   // Tile by tile in image order
+    FILE_OFFSET  // Contiguous batches of tiles in ascending file offset order, prefetched with one sequential read
+  };
+
+  Order order{Order::ROW_MAJOR};
+  PixelFormat pixel_format{PixelFormat::RGB};
+  /**
+   * The maximum amount of image bands being decoded or consumed at once when streaming the image.
+   */
+  std::int32_t max_bands_in_flight{4};
+  /**
+   * The byte budget of the decoded tiles and compiled Huffman code books kept for random access to single tiles.
+   */
+  std::size_t tile_cache_byte_count{64 << 20};
+};
+
+/**
+ * A band of consecutive image rows, one image tile high, in the pixel format the image is decoded in.
+ * Only valid for the duration of the band callback it is passed to.
+ */
+struct ImageBand final {
+  std::int32_t y{0};
+  std::int32_t row_count{0};
+  std::int32_t width{0};
+  PixelFormat pixel_format{PixelFormat::RGB};
+  std::span<const std::uint8_t> bytes{};
+
+  /**
+   * Expand the band to RGB.
+   * @param palette to resolve palette indices with
+   * @param rgb_bytes the memory to expand into, at least width x row_count x 3 bytes
+   */
+  void expandRgb(const palette::Palette& palette, std::span<std::uint8_t> rgb_bytes) const;
+};
+
+/**
+ * Expand consecutive pixels to RGB.
+ * @param pixel_format of the pixels
+ * @param pixel_bytes the bytes of the pixels
+ * @param palette to resolve palette indices with
+ * @param rgb_bytes the memory to expand into, its size determines the amount of pixels
+ */
+void expandRgb(PixelFormat pixel_format, std::span<const std::uint8_t> pixel_bytes, const palette::Palette& palette,
+               std::span<std::uint8_t> rgb_bytes);
+
+using image_band_consumer_t = std::function<void(const ImageBand&)>;
+
 /**
  * +--------+-------------------+--------------------------------------------+
  * | Offset | Size (Bytes)      | Content                                    |
@@ -33,124 +97,443 @@ export namespace qct::image {
  */
 struct ImageIndex final {
   static constexpr byte_offset_t BYTE_OFFSET{0x45A0};
+  static constexpr byte_offset_t MAX_READ_BATCH_BYTE_COUNT{1 << 20};
 
+  PixelFormat pixel_format{PixelFormat::RGB};
   std::vector<std::uint8_t> image_bytes{};
 
   [[nodiscard]] auto imageBytesView() const;
-  [[nodiscard]] std::vector<std::uint8_t> channelBytes(std::int32_t channel_index) const;
 
-  static ImageIndex parse(const std::filesystem::path& filepath, const meta::Metadata& metadata,
-                          const palette::Palette& palette);
+  /**
+   * Get the image as RGB, expanding it if indexed.
+   * @param palette to resolve palette indices with
+   * @return the RGB bytes of the image
+   */
+  [[nodiscard]] std::vector<std::uint8_t> rgbBytes(const palette::Palette& palette) const;
+
+  /**
+   * Expand consecutive pixels of the image to RGB, e.g. to convert an indexed image in strips.
+   * @param palette to resolve palette indices with
+   * @param pixel_offset the index of the first pixel in row-major order
+   * @param rgb_bytes the memory to expand into, its size determines the amount of pixels
+   */
+  void expandRgb(const palette::Palette& palette, std::size_t pixel_offset, std::span<std::uint8_t> rgb_bytes) const;
+
+  /**
+   * Parse the image index by decoding all image tiles in parallel.
+   * @param file the QCT-file
+   * @param tile_directory of the QCT-file
+   * @param metadata of the QCT-file
+   * @param palette of the QCT-file
+   * @param thread_pool to decode the image tiles with
+   * @param decode_options options for decoding the image tiles
+   * @return the parsed image index
+   */
+  static ImageIndex parse(const util::FileSource& file, const TileDirectory& tile_directory,
+                          const meta::Metadata& metadata, const palette::Palette& palette,
+                          util::ThreadPool& thread_pool, const DecodeOptions& decode_options = {});
+
+  /**
+   * Decode the image band by band, top to bottom, without ever holding the whole image in memory.
+   * The tiles of the next few bands are decoded in parallel, while the calling thread consumes the completed bands
+   * in order. At most max_bands_in_flight band buffers exist at any time. The tiles of a band are decoded in the
+   * decode order of the options, in file offset order as contiguous batches of the band.
+   * @param file the QCT-file
+   * @param tile_directory of the QCT-file
+   * @param metadata of the QCT-file
+   * @param palette of the QCT-file
+   * @param thread_pool to decode the image tiles with
+   * @param decode_options options for decoding the image tiles
+   * @param band_consumer invoked with every band in order, on the calling thread
+   * @throws QctException if an image tile cannot be decoded, or anything thrown by the band consumer
+   */
+  static void streamBands(const util::FileSource& file, const TileDirectory& tile_directory,
+                          const meta::Metadata& metadata, const palette::Palette& palette,
+                          util::ThreadPool& thread_pool, const DecodeOptions& decode_options,
+                          const image_band_consumer_t& band_consumer);
+
+  /**
+   * Pass the bands of the decoded image to the given consumer, top to bottom.
+   * @param width_tiles the width of the image in tiles
+   * @param band_consumer invoked with every band in order
+   */
+  void forEachBand(std::int32_t width_tiles, const image_band_consumer_t& band_consumer) const;
+
+  /**
+   * Read the pointers (byte offsets) to all image tiles from the image index in a single read.
+   * @param file the file to read from
+   * @param metadata of the QCT-file
+   * @return the pointers (byte offsets) of the image tiles in row-major order
+   */
+  static std::vector<std::uint32_t> readImageTilePointers(const util::FileSource& file,
+                                                          const meta::Metadata& metadata);
+
+  /**
+   * Build the directory of the compressed byte ranges of all image tiles, reporting tiles which cannot be decoded.
+   * @param file the file to read from
+   * @param metadata of the QCT-file
+   * @return the tile directory
+   */
+  static TileDirectory readTileDirectory(const util::FileSource& file, const meta::Metadata& metadata);
 
  private:
   struct ImageTileParseTask final {
-    const std::filesystem::path& filepath;
-    const meta::Metadata& metadata;
+    const util::FileSource& file;
     const palette::Palette& palette;
-    const std::int32_t y_tile;
-    const std::int32_t x_tile;
+    decode::HuffmanCodeBookCache& code_book_cache;
+    const TileExtent& extent;
   };
 
   /**
-   * Parse an image tile from the file and store it in the image bytes.
+   * Decode a range of image tiles in parallel, in the given decode order.
+   * @param file the QCT-file
+   * @param tile_directory of the QCT-file
+   * @param order the decode order
+   * @param first_tile_index the row-major index of the first tile of the range
+   * @param tile_count the amount of tiles of the range
+   * @param thread_pool to decode the image tiles with
+   * @param parse_tile invoked with the row-major index of every tile of the range, concurrently
+   */
+  static void decodeTiles(const util::FileSource& file, const TileDirectory& tile_directory, DecodeOptions::Order order,
+                          std::int32_t first_tile_index, std::int32_t tile_count, util::ThreadPool& thread_pool,
+                          const std::function<void(std::int32_t)>& parse_tile);
+
+  /**
+   * Parse an image tile from the file and store it in the given view.
    * @param task the image tile parse task
-   * @param image_bytes the image bytes to store the parsed tile in
+   * @param image_tile_view the view to store the parsed tile in
    */
-  static std::future<void> parseImageTileAsync(ImageTileParseTask&& task, std::vector<std::uint8_t>& image_bytes);
+  static void parseImageTile(const ImageTileParseTask& task, const ImageTileView& image_tile_view);
 
   /**
-   * Read the pointer (byte offset) to an image tile from the image index.
-   * @param file the file to read from
-   * @param width_tiles width of the image in tiles
-   * @param y_tile the y index of the tile to read
-   * @param x_tile the x index of the tile to read
-   * @return the pointer (byte offset) of the image tile
+   * Get a view of an image tile within the image bytes, for the tile to be decoded into.
+   * @param y_tile the y index of the tile
+   * @param x_tile the x index of the tile
+   * @param width_tiles the width of the image in tiles
+   * @param pixel_format the pixel format of the image
+   * @param image_bytes the bytes of the image
+   * @return view of the image tile
+   */
+  static ImageTileView imageTileView(std::int32_t y_tile, std::int32_t x_tile, std::int32_t width_tiles,
+                                     PixelFormat pixel_format, std::vector<std::uint8_t>& image_bytes);
+};
+
+/**
+ * The tile directory of a QCT-file, read on first use and shared by everything decoding tiles of the file.
+ * Thread-safe, concurrent callers wait for the single read to finish.
+ */
+class LazyTileDirectory final {
+ public:
+  /**
+   * @param file_source the QCT-file
+   * @param metadata of the QCT-file
    */
-  static std::int32_t readImageTilePointer(std::ifstream& file, std::int32_t width_tiles, std::int32_t y_tile,
-                                           std::int32_t x_tile);
+  LazyTileDirectory(std::shared_ptr<const util::FileSource> file_source, meta::Metadata metadata);
 
   /**
-   * Copy the bytes of an image tile into the image bytes.
-   * @param y_tile the y index of the tile to copy
-   * @param x_tile the x index of the tile to copy
-   * @param tile_bytes the bytes of the tile to copy
-   * @param image_width_bytes the width of the image in bytes
-   * @param image_bytes the bytes of the image to copy into
+   * Get the tile directory, reading it on the first call.
+   * @return the tile directory
+   * @throws QctException if the tile directory cannot be read, the next call retries
    */
-  static void copyTileToImage(std::int32_t y_tile, std::int32_t x_tile, const ImageTile::bytes_2d_t& tile_bytes,
-                              std::int32_t image_width_bytes, std::vector<std::uint8_t>& image_bytes);
+  [[nodiscard]] const TileDirectory& get() const;
+
+ private:
+  std::shared_ptr<const util::FileSource> file_source_;
+  meta::Metadata metadata_;
+  mutable std::once_flag once_flag_{};
+  mutable TileDirectory tile_directory_{};
+};
+
+/**
+ * An image index which decodes the image tiles only once its pixels are first requested,
+ * so that the header of a QCT-file can be read without touching the tile data.
+ * Thread-safe, concurrent callers wait for the single decode to finish.
+ */
+class LazyImageIndex final {
+ public:
+  /**
+   * @param file_source the QCT-file
+   * @param tile_directory of the QCT-file
+   * @param metadata of the QCT-file
+   * @param palette of the QCT-file
+   * @param thread_pool to decode the image tiles with, must outlive the lazy image index
+   * @param decode_options options for decoding the image tiles
+   */
+  LazyImageIndex(std::shared_ptr<const util::FileSource> file_source,
+                 std::shared_ptr<const LazyTileDirectory> tile_directory, meta::Metadata metadata,
+                 palette::Palette palette, util::ThreadPool& thread_pool, const DecodeOptions& decode_options);
+
+  /**
+   * Get the image index, decoding the image tiles on the first call.
+   * @return the image index
+   * @throws QctException if the image tiles cannot be decoded, the next call retries
+   */
+  [[nodiscard]] const ImageIndex& get() const;
+
+  /**
+   * Pass the bands of the image to the given consumer, top to bottom. Served from the image index if it has already
+   * been decoded, otherwise the image is streamed band by band without being kept.
+   * @param band_consumer invoked with every band in order, on the calling thread
+   * @throws QctException if the image tiles cannot be decoded, or anything thrown by the band consumer
+   */
+  void forEachBand(const image_band_consumer_t& band_consumer) const;
+
+ private:
+  std::shared_ptr<const util::FileSource> file_source_;
+  std::shared_ptr<const LazyTileDirectory> tile_directory_;
+  meta::Metadata metadata_;
+  palette::Palette palette_;
+  util::ThreadPool& thread_pool_;
+  DecodeOptions decode_options_;
+  mutable std::once_flag once_flag_{};
+  mutable ImageIndex image_index_{};
+  mutable std::atomic<bool> decoded_{false};
 };
 
+void ImageBand::expandRgb(const palette::Palette& palette, const std::span<std::uint8_t> rgb_bytes) const {
+  image::expandRgb(pixel_format, bytes, palette,
+                   rgb_bytes.first(static_cast<std::size_t>(width) * row_count * palette::COLOR_CHANNELS));
+}
+
+void expandRgb(const PixelFormat pixel_format, const std::span<const std::uint8_t> pixel_bytes,
+               const palette::Palette& palette, const std::span<std::uint8_t> rgb_bytes) {
+  const std::size_t pixel_count = rgb_bytes.size() / palette::COLOR_CHANNELS;
+  if (pixel_format == PixelFormat::RGB) {
+    std::ranges::copy_n(pixel_bytes.begin(), pixel_count * palette::COLOR_CHANNELS, rgb_bytes.begin());
+    return;
+  }
+  for (std::size_t i = 0; i < pixel_count; ++i) {
+    const auto [red, green, blue] = palette.colors[pixel_bytes[i]];
+    rgb_bytes[i * 3 + 0] = red;
+    rgb_bytes[i * 3 + 1] = green;
+    rgb_bytes[i * 3 + 2] = blue;
+  }
+}
+
 auto ImageIndex::imageBytesView() const {
   return std::span(image_bytes.data(), image_bytes.size());
 }
 
-std::vector<std::uint8_t> ImageIndex::channelBytes(const std::int32_t channel_index) const {
-  if (channel_index < 0 || palette::COLOR_CHANNELS <= channel_index)
-    throw std::invalid_argument{"Invalid channel index"};
-  const auto channel_view = std::views::iota(0u, image_bytes.size() / 3) |
-                            std::views::transform([this, channel_index](auto idx) -> const std::uint8_t& {
-                              return image_bytes[idx * 3 + channel_index];
-                            });
-  // TODO: Replace with std::ranges::to
-  std::vector<std::uint8_t> result;
-  for (const auto& value : channel_view) {
-    result.push_back(value);
+std::vector<std::uint8_t> ImageIndex::rgbBytes(const palette::Palette& palette) const {
+  if (pixel_format == PixelFormat::RGB) {
+    return image_bytes;
   }
-  return result;
+  std::vector<std::uint8_t> rgb_bytes(image_bytes.size() * palette::COLOR_CHANNELS);
+  expandRgb(palette, 0, rgb_bytes);
+  return rgb_bytes;
+}
+
+void ImageIndex::expandRgb(const palette::Palette& palette, const std::size_t pixel_offset,
+                           const std::span<std::uint8_t> rgb_bytes) const {
+  image::expandRgb(pixel_format, imageBytesView().subspan(pixel_offset * bytesPerPixel(pixel_format)), palette,
+                   rgb_bytes);
 }
 
-ImageIndex ImageIndex::parse(const std::filesystem::path& filepath, const meta::Metadata& metadata,
-                             const palette::Palette& palette) {
+ImageIndex ImageIndex::parse(const util::FileSource& file, const TileDirectory& tile_directory,
+                             const meta::Metadata& metadata, const palette::Palette& palette,
+                             util::ThreadPool& thread_pool, const DecodeOptions& decode_options) {
+  const PixelFormat pixel_format = decode_options.pixel_format;
   std::vector<std::uint8_t> image_bytes(metadata.height_tiles * metadata.width_tiles *
-                                        static_cast<std::size_t>(ImageTile::BYTE_COUNT));
-  std::vector<std::future<void>> image_tile_futures;
-  image_tile_futures.reserve(metadata.height_tiles * metadata.width_tiles);
-  for (std::int32_t y_tile = 0; y_tile < metadata.height_tiles; ++y_tile) {
-    for (std::int32_t x_tile = 0; x_tile < metadata.width_tiles; ++x_tile) {
-      image_tile_futures.emplace_back(parseImageTileAsync(
-          {.filepath = filepath, .metadata = metadata, .palette = palette, .y_tile = y_tile, .x_tile = x_tile},
-          image_bytes));
+                                        static_cast<std::size_t>(ImageTile::PIXEL_COUNT * bytesPerPixel(pixel_format)));
+  decode::HuffmanCodeBookCache code_book_cache{};
+  const auto parse_tile = [&](const std::int32_t tile_index) {
+    parseImageTile({.file = file,
+                    .palette = palette,
+                    .code_book_cache = code_book_cache,
+                    .extent = tile_directory.extents[tile_index]},
+                   imageTileView(tile_index / metadata.width_tiles, tile_index % metadata.width_tiles,
+                                 metadata.width_tiles, pixel_format, image_bytes));
+  };
+  decodeTiles(file, tile_directory, decode_options.order, 0, tile_directory.tileCount(), thread_pool, parse_tile);
+  return {.pixel_format = pixel_format, .image_bytes = std::move(image_bytes)};
+}
+
+void ImageIndex::decodeTiles(const util::FileSource& file, const TileDirectory& tile_directory,
+                             const DecodeOptions::Order order, const std::int32_t first_tile_index,
+                             const std::int32_t tile_count, util::ThreadPool& thread_pool,
+                             const std::function<void(std::int32_t)>& parse_tile) {
+  switch (order) {
+    case DecodeOptions::Order::ROW_MAJOR:
+      thread_pool.parallelFor(tile_count,
+                              [&](const std::int32_t index) { parse_tile(first_tile_index + index); });
+      break;
+    case DecodeOptions::Order::FILE_OFFSET: {
+      // Every worker claims the next batch in file order, so the range is consumed front to back as a whole
+      const std::vector<TileReadBatch> read_batches =
+          tile_directory.readBatches(MAX_READ_BATCH_BYTE_COUNT, first_tile_index, tile_count);
+      std::atomic<std::size_t> next_read_batch_index{0};
+      const auto worker_count = static_cast<std::int32_t>(
+          std::min(read_batches.size(), static_cast<std::size_t>(thread_pool.threadCount())));
+      thread_pool.parallelFor(worker_count, [&](std::int32_t) {
+        for (std::size_t i = next_read_batch_index++; i < read_batches.size(); i = next_read_batch_index++) {
+          const TileReadBatch& read_batch = read_batches[i];
+          file.prefetch(read_batch.byte_offset, read_batch.byte_count);
+          std::ranges::for_each(read_batch.tile_indices, parse_tile);
+        }
+      });
+      break;
     }
   }
-  std::ranges::for_each(image_tile_futures, [](auto& future) { future.wait(); });
-  return {.image_bytes = std::move(image_bytes)};
-}
-
-std::future<void> ImageIndex::parseImageTileAsync(ImageTileParseTask&& task, std::vector<std::uint8_t>& image_bytes) {
-  return std::async(
-      std::launch::async,
-      [&image_bytes](const ImageTileParseTask& t) {
-        std::ifstream file{t.filepath, std::ios::binary};
-        const byte_offset_t image_tile_byte_offset =
-            readImageTilePointer(file, t.metadata.width_tiles, t.y_tile, t.x_tile);
-        const ImageTile::Encoding tile_encoding = ImageTile::encodingOf(file, image_tile_byte_offset);
-        const auto image_tile_decoder = decode::makeImageTileDecoder(tile_encoding, t.palette);
-        std::visit(crtp::Overloaded{[&](auto& decoder) {
-                     const ImageTile::bytes_2d_t tile_bytes_2d = decoder.decodeTile(file, image_tile_byte_offset);
-                     copyTileToImage(t.y_tile, t.x_tile, tile_bytes_2d,
-                                     t.metadata.width_tiles * ImageTile::ROW_BYTE_COUNT, image_bytes);
-                   }},
-                   image_tile_decoder);
-      },
-      task);
-}
-
-std::int32_t ImageIndex::readImageTilePointer(std::ifstream& file, const std::int32_t width_tiles,
-                                              const std::int32_t y_tile, const std::int32_t x_tile) {
-  const byte_offset_t image_tile_pointer_offset = (width_tiles * y_tile + x_tile) * 0x04;
-  return util::readInt(file, BYTE_OFFSET + image_tile_pointer_offset);
-}
-
-void ImageIndex::copyTileToImage(const std::int32_t y_tile, const std::int32_t x_tile,
-                                 const ImageTile::bytes_2d_t& tile_bytes, const std::int32_t image_width_bytes,
-                                 std::vector<std::uint8_t>& image_bytes) {
+}
+
+void ImageIndex::streamBands(const util::FileSource& file, const TileDirectory& tile_directory,
+                             const meta::Metadata& metadata, const palette::Palette& palette,
+                             util::ThreadPool& thread_pool, const DecodeOptions& decode_options,
+                             const image_band_consumer_t& band_consumer) {
+  const PixelFormat pixel_format = decode_options.pixel_format;
+  const std::int32_t band_count = metadata.height_tiles;
+  const std::int32_t band_buffer_count = std::max(1, std::min(decode_options.max_bands_in_flight, band_count));
+  decode::HuffmanCodeBookCache code_book_cache{};
+  // A band is one row of tiles, so a band buffer is laid out like an image one tile high
+  const std::size_t band_byte_count =
+      metadata.width_tiles * static_cast<std::size_t>(ImageTile::PIXEL_COUNT * bytesPerPixel(pixel_format));
+  std::vector<std::vector<std::uint8_t>> band_buffers(band_buffer_count, std::vector<std::uint8_t>(band_byte_count));
+  std::deque<std::future<void>> band_futures{};
+  const auto submit_band = [&](const std::int32_t y_tile) {
+    std::vector<std::uint8_t>& band_buffer = band_buffers[y_tile % band_buffer_count];
+    band_futures.push_back(thread_pool.submit([&, y_tile] {
+      const std::int32_t first_tile_index = y_tile * metadata.width_tiles;
+      decodeTiles(file, tile_directory, decode_options.order, first_tile_index, metadata.width_tiles, thread_pool,
+                  [&](const std::int32_t tile_index) {
+                    parseImageTile({.file = file,
+                                    .palette = palette,
+                                    .code_book_cache = code_book_cache,
+                                    .extent = tile_directory.extents[tile_index]},
+                                   imageTileView(0, tile_index - first_tile_index, metadata.width_tiles, pixel_format,
+                                                 band_buffer));
+                  });
+    }));
+  };
+  try {
+    for (std::int32_t y_tile = 0; y_tile < band_buffer_count; ++y_tile) {
+      submit_band(y_tile);
+    }
+    for (std::int32_t y_tile = 0; y_tile < band_count; ++y_tile) {
+      thread_pool.wait(band_futures.front());
+      band_futures.pop_front();
+      band_consumer({.y = y_tile * ImageTile::HEIGHT,
+                     .row_count = ImageTile::HEIGHT,
+                     .width = metadata.width_tiles * ImageTile::WIDTH,
+                     .pixel_format = pixel_format,
+                     .bytes = band_buffers[y_tile % band_buffer_count]});
+      // The buffer of the consumed band is free again
+      if (y_tile + band_buffer_count < band_count) {
+        submit_band(y_tile + band_buffer_count);
+      }
+    }
+  } catch (...) {
+    // The bands still in flight reference the band buffers
+    for (std::future<void>& band_future : band_futures) {
+      try {
+        thread_pool.wait(band_future);
+      } catch (...) {
+      }
+    }
+    throw;
+  }
+}
+
+void ImageIndex::forEachBand(const std::int32_t width_tiles, const image_band_consumer_t& band_consumer) const {
+  const std::size_t band_byte_count =
+      width_tiles * static_cast<std::size_t>(ImageTile::PIXEL_COUNT * bytesPerPixel(pixel_format));
+  const std::span<const std::uint8_t> bytes = imageBytesView();
+  for (std::size_t band_index = 0; band_index * band_byte_count < bytes.size(); ++band_index) {
+    band_consumer({.y = static_cast<std::int32_t>(band_index) * ImageTile::HEIGHT,
+                   .row_count = ImageTile::HEIGHT,
+                   .width = width_tiles * ImageTile::WIDTH,
+                   .pixel_format = pixel_format,
+                   .bytes = bytes.subspan(band_index * band_byte_count, band_byte_count)});
+  }
+}
+
+void ImageIndex::parseImageTile(const ImageTileParseTask& task, const ImageTileView& image_tile_view) {
+  const auto image_tile_decoder =
+      decode::makeImageTileDecoder(task.extent.encoding, task.palette, &task.code_book_cache);
+  std::visit(crtp::Overloaded{[&](auto& decoder) {
+               const std::span<const std::uint8_t> tile_bytes =
+                   task.file.bytes(task.extent.byte_offset, task.extent.byte_count);
+               decoder.decodeTile(tile_bytes, image_tile_view);
+             }},
+             image_tile_decoder);
+}
+
+std::vector<std::uint32_t> ImageIndex::readImageTilePointers(const util::FileSource& file,
+                                                             const meta::Metadata& metadata) {
+  const std::int32_t tile_count = metadata.height_tiles * metadata.width_tiles;
+  const std::span<const std::uint8_t> bytes = util::readBytes(file, BYTE_OFFSET, tile_count * 0x04);
+  std::vector<std::uint32_t> image_tile_pointers(tile_count);
+  for (std::int32_t i = 0; i < tile_count; ++i) {
+    image_tile_pointers[i] = static_cast<std::uint32_t>(bytes[i * 4 + 0]) << 0 |
+                             static_cast<std::uint32_t>(bytes[i * 4 + 1]) << 8 |
+                             static_cast<std::uint32_t>(bytes[i * 4 + 2]) << 16 |
+                             static_cast<std::uint32_t>(bytes[i * 4 + 3]) << 24;
+  }
+  return image_tile_pointers;
+}
+
+TileDirectory ImageIndex::readTileDirectory(const util::FileSource& file, const meta::Metadata& metadata) {
+  const std::vector<std::uint32_t> image_tile_pointers = readImageTilePointers(file, metadata);
+  const byte_offset_t tile_data_byte_offset = BYTE_OFFSET + static_cast<byte_offset_t>(image_tile_pointers.size()) * 4;
+  TileDirectory tile_directory = TileDirectory::build(file, metadata.width_tiles, metadata.height_tiles,
+                                                      image_tile_pointers, tile_data_byte_offset);
+  // Reported once per file, instead of by every tile from the workers
+  const auto pixel_packing_tile_count = std::ranges::count(tile_directory.extents, ImageTile::Encoding::PIXEL_PACKING,
+                                                           &TileExtent::encoding);
+  if (pixel_packing_tile_count > 0) {
+    std::cerr << std::format("{} image tiles use pixel packing, which is not implemented yet, they are filled with the "
+                             "first palette color",
+                             pixel_packing_tile_count)
+              << std::endl;
+  }
+  return tile_directory;
+}
+
+ImageTileView ImageIndex::imageTileView(const std::int32_t y_tile, const std::int32_t x_tile,
+                                        const std::int32_t width_tiles, const PixelFormat pixel_format,
+                                        std::vector<std::uint8_t>& image_bytes) {
+  const std::int32_t tile_width_bytes = ImageTile::WIDTH * bytesPerPixel(pixel_format);
+  const byte_offset_t image_width_bytes = width_tiles * static_cast<byte_offset_t>(tile_width_bytes);
   const byte_offset_t tile_image_byte_offset =
-      y_tile * ImageTile::HEIGHT * static_cast<byte_offset_t>(image_width_bytes) + x_tile * ImageTile::ROW_BYTE_COUNT;
-  for (std::int32_t tile_row = 0; tile_row < ImageTile::HEIGHT; ++tile_row) {
-    const ImageTile::row_bytes_t& tile_row_bytes = tile_bytes[tile_row];
-    const byte_offset_t row_offset = tile_image_byte_offset + tile_row * image_width_bytes;
-    std::ranges::copy(tile_row_bytes, image_bytes.begin() + row_offset);
+      y_tile * ImageTile::HEIGHT * image_width_bytes + x_tile * static_cast<byte_offset_t>(tile_width_bytes);
+  return {.data = image_bytes.data() + tile_image_byte_offset,
+          .row_stride = static_cast<std::size_t>(image_width_bytes),
+          .pixel_format = pixel_format};
+}
+
+LazyTileDirectory::LazyTileDirectory(std::shared_ptr<const util::FileSource> file_source, meta::Metadata metadata)
+    : file_source_{std::move(file_source)}, metadata_{std::move(metadata)} {}
+
+const TileDirectory& LazyTileDirectory::get() const {
+  std::call_once(once_flag_, [this] { tile_directory_ = ImageIndex::readTileDirectory(*file_source_, metadata_); });
+  return tile_directory_;
+}
+
+LazyImageIndex::LazyImageIndex(std::shared_ptr<const util::FileSource> file_source,
+                               std::shared_ptr<const LazyTileDirectory> tile_directory, meta::Metadata metadata,
+                               palette::Palette palette, util::ThreadPool& thread_pool,
+                               const DecodeOptions& decode_options)
+    : file_source_{std::move(file_source)},
+      tile_directory_{std::move(tile_directory)},
+      metadata_{std::move(metadata)},
+      palette_{std::move(palette)},
+      thread_pool_{thread_pool},
+      decode_options_{decode_options} {}
+
+const ImageIndex& LazyImageIndex::get() const {
+  std::call_once(once_flag_, [this] {
+    image_index_ =
+        ImageIndex::parse(*file_source_, tile_directory_->get(), metadata_, palette_, thread_pool_, decode_options_);
+    decoded_.store(true, std::memory_order_release);
+  });
+  return image_index_;
+}
+
+void LazyImageIndex::forEachBand(const image_band_consumer_t& band_consumer) const {
+  if (decoded_.load(std::memory_order_acquire)) {
+    image_index_.forEachBand(metadata_.width_tiles, band_consumer);
+  } else {
+    ImageIndex::streamBands(*file_source_, tile_directory_->get(), metadata_, palette_, thread_pool_, decode_options_,
+                            band_consumer);
   }
 }
 
@@ -0,0 +1,151 @@
+module;
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <span>
+#include <utility>
+#include <variant>
+#include <vector>
+
+export module qct:image.reader;
+
+import :common.crtp;
+import :common.exception;
+import :image.cache;
+import :image.decode;
+import :image.decode.huffman;
+import :image.directory;
+import :image.index;
+import :image.tile;
+import :image.writer;
+import :meta;
+import :palette;
+import :util.file_source;
+
+export namespace qct::image {
+/**
+ * Random access to the image, decoding single tiles on first use and keeping them in a tile cache.
+ * The tile directory is only read on the first access. Thread-safe.
+ */
+class TileReader final {
+ public:
+  /**
+   * @param file_source the QCT-file
+   * @param tile_directory of the QCT-file
+   * @param metadata of the QCT-file
+   * @param palette of the QCT-file
+   * @param pixel_format the pixel format to decode the tiles in
+   * @param cache_byte_count the byte budget of the tile cache, shared with the compiled Huffman code books
+   */
+  TileReader(std::shared_ptr<const util::FileSource> file_source,
+             std::shared_ptr<const LazyTileDirectory> tile_directory, const meta::Metadata& metadata,
+             palette::Palette palette, PixelFormat pixel_format, std::size_t cache_byte_count);
+
+  [[nodiscard]] PixelFormat pixelFormat() const { return pixel_format_; }
+
+  /**
+   * Get a decoded tile.
+   * @param y_tile the y index of the tile
+   * @param x_tile the x index of the tile
+   * @return the decoded tile
+   * @throws QctException if the tile is outside the image or cannot be decoded
+   */
+  [[nodiscard]] std::shared_ptr<const DecodedTile> tile(std::int32_t y_tile, std::int32_t x_tile) const;
+
+  /**
+   * Get a rectangular window of the image, decoding only the tiles it covers.
+   * @param x the left column of the window
+   * @param y the top row of the window
+   * @param width the width of the window in pixels
+   * @param height the height of the window in pixels
+   * @return the bytes of the window in row-major order, in the pixel format of the reader
+   * @throws QctException if the window is not within the image, or a tile cannot be decoded
+   */
+  [[nodiscard]] std::vector<std::uint8_t> window(std::int32_t x, std::int32_t y, std::int32_t width,
+                                                 std::int32_t height) const;
+
+ private:
+  // An eighth of the cache budget holds compiled Huffman code books, the rest decoded tiles
+  static constexpr std::size_t CODE_BOOK_CACHE_SHARE{8};
+
+  std::shared_ptr<const util::FileSource> file_source_;
+  std::shared_ptr<const LazyTileDirectory> tile_directory_;
+  meta::Metadata metadata_;
+  palette::Palette palette_;
+  PixelFormat pixel_format_;
+  mutable decode::HuffmanCodeBookCache code_book_cache_;
+  mutable TileCache tile_cache_;
+
+  [[nodiscard]] std::shared_ptr<const DecodedTile> decodeTile(const TileExtent& extent) const;
+};
+
+TileReader::TileReader(std::shared_ptr<const util::FileSource> file_source,
+                       std::shared_ptr<const LazyTileDirectory> tile_directory, const meta::Metadata& metadata,
+                       palette::Palette palette, const PixelFormat pixel_format, const std::size_t cache_byte_count)
+    : file_source_{std::move(file_source)},
+      tile_directory_{std::move(tile_directory)},
+      metadata_{metadata},
+      palette_{std::move(palette)},
+      pixel_format_{pixel_format},
+      code_book_cache_{cache_byte_count / CODE_BOOK_CACHE_SHARE},
+      tile_cache_{cache_byte_count - cache_byte_count / CODE_BOOK_CACHE_SHARE} {}
+
+std::shared_ptr<const DecodedTile> TileReader::tile(const std::int32_t y_tile, const std::int32_t x_tile) const {
+  if (y_tile < 0 || metadata_.height_tiles <= y_tile || x_tile < 0 || metadata_.width_tiles <= x_tile) {
+    throw QctException{std::format("Tile y={}, x={} is outside the image", y_tile, x_tile)};
+  }
+  const std::int32_t tile_index = y_tile * metadata_.width_tiles + x_tile;
+  if (std::shared_ptr<const DecodedTile> decoded_tile = tile_cache_.find(tile_index)) {
+    return decoded_tile;
+  }
+  // Concurrent misses of the same tile decode it twice, the cache keeps the first
+  return tile_cache_.insert(tile_index, decodeTile(tile_directory_->get().extents[tile_index]));
+}
+
+std::vector<std::uint8_t> TileReader::window(const std::int32_t x, const std::int32_t y, const std::int32_t width,
+                                             const std::int32_t height) const {
+  const std::int32_t image_width = metadata_.width_tiles * ImageTile::WIDTH;
+  const std::int32_t image_height = metadata_.height_tiles * ImageTile::HEIGHT;
+  if (x < 0 || y < 0 || width < 0 || height < 0 || image_width - x < width || image_height - y < height) {
+    throw QctException{std::format("Window x={}, y={}, width={}, height={} is outside the image", x, y, width, height)};
+  }
+  const auto bytes_per_pixel = static_cast<std::size_t>(bytesPerPixel(pixel_format_));
+  std::vector<std::uint8_t> window_bytes(static_cast<std::size_t>(width) * height * bytes_per_pixel);
+  for (std::int32_t y_tile = y / ImageTile::HEIGHT; y_tile * ImageTile::HEIGHT < y + height; ++y_tile) {
+    for (std::int32_t x_tile = x / ImageTile::WIDTH; x_tile * ImageTile::WIDTH < x + width; ++x_tile) {
+      const std::shared_ptr<const DecodedTile> decoded_tile = tile(y_tile, x_tile);
+      // The intersection of the window and the tile in image coordinates
+      const std::int32_t x_begin = std::max(x, x_tile * ImageTile::WIDTH);
+      const std::int32_t x_end = std::min(x + width, (x_tile + 1) * ImageTile::WIDTH);
+      const std::int32_t y_begin = std::max(y, y_tile * ImageTile::HEIGHT);
+      const std::int32_t y_end = std::min(y + height, (y_tile + 1) * ImageTile::HEIGHT);
+      for (std::int32_t row = y_begin; row < y_end; ++row) {
+        const std::span<const std::uint8_t> tile_row = decoded_tile->row(row - y_tile * ImageTile::HEIGHT);
+        std::ranges::copy(tile_row.subspan((x_begin - x_tile * ImageTile::WIDTH) * bytes_per_pixel,
+                                           (x_end - x_begin) * bytes_per_pixel),
+                          window_bytes.begin() + ((row - y) * static_cast<std::size_t>(width) + (x_begin - x)) *
+                                                     bytes_per_pixel);
+      }
+    }
+  }
+  return window_bytes;
+}
+
+std::shared_ptr<const DecodedTile> TileReader::decodeTile(const TileExtent& extent) const {
+  const std::size_t row_byte_count = ImageTile::WIDTH * static_cast<std::size_t>(bytesPerPixel(pixel_format_));
+  auto decoded_tile = std::make_shared<DecodedTile>(DecodedTile{
+      .pixel_format = pixel_format_, .bytes = std::vector<std::uint8_t>(ImageTile::HEIGHT * row_byte_count)});
+  const ImageTileView image_tile_view{
+      .data = decoded_tile->bytes.data(), .row_stride = row_byte_count, .pixel_format = pixel_format_};
+  const auto image_tile_decoder = decode::makeImageTileDecoder(extent.encoding, palette_, &code_book_cache_);
+  std::visit(crtp::Overloaded{[&](auto& decoder) {
+               decoder.decodeTile(file_source_->bytes(extent.byte_offset, extent.byte_count), image_tile_view);
+             }},
+             image_tile_decoder);
+  return decoded_tile;
+}
+
+}  // namespace qct::image
@@ -2,16 +2,32 @@ module;
 
 #include <array>
 #include <cstdint>
-#include <fstream>
 
 export module qct:image.tile;
 
 import :common.alias;
 import :palette;
 import :palette.color;
+import :util.file_source;
 import :util.reader;
 
 export namespace qct::image {
+/**
+ * The representation of the pixels of a decoded image.
+ */
+enum class PixelFormat {
+  RGB,     // 3 bytes per pixel, the color of the pixel
+  INDEXED  // 1 byte per pixel, the index of the color of the pixel in the palette
+};
+
+/**
+ * @param pixel_format the pixel format
+ * @return the amount of bytes per pixel
+ */
+constexpr std::int32_t bytesPerPixel(const PixelFormat pixel_format) {
+  return pixel_format == PixelFormat::INDEXED ? 1 : palette::COLOR_CHANNELS;
+}
+
 /**
  * Represents a 64 x 64 tile of the image. Tiles may be encoded with different algorithms for efficiency purposes.
  */
@@ -42,10 +58,10 @@ struct ImageTile final {
    * @param[in] image_tile_byte_offset image tile byte offset
    * @return encoding of the image tile
    */
-  static Encoding encodingOf(std::ifstream& file, byte_offset_t image_tile_byte_offset);
+  static Encoding encodingOf(const util::FileSource& file, byte_offset_t image_tile_byte_offset);
 };
 
-ImageTile::Encoding ImageTile::encodingOf(std::ifstream& file, const byte_offset_t image_tile_byte_offset) {
+ImageTile::Encoding ImageTile::encodingOf(const util::FileSource& file, const byte_offset_t image_tile_byte_offset) {
   const std::uint8_t first_byte = util::readByte(file, image_tile_byte_offset);
   if (first_byte == 0 || first_byte == 255)
     return Encoding::HUFFMAN_CODING;
@@ -0,0 +1,133 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+export module qct:image.writer;
+
+import :image.tile;
+import :palette;
+import :palette.color;
+import :util.fill;
+
+export namespace qct::image {
+/**
+ * The rows of a tile are stored interlaced, in the bit-reversed order of their 6-bit row indices.
+ * Bit reversal is its own inverse, so this maps a stored row to its row within the tile and vice versa.
+ */
+constexpr std::array<std::int32_t, ImageTile::HEIGHT> DEINTERLACED_ROWS = [] {
+  std::array<std::int32_t, ImageTile::HEIGHT> rows{};
+  for (std::int32_t row = 0; row < ImageTile::HEIGHT; ++row) {
+    for (std::int32_t bit = 0; bit < 6; ++bit) {
+      rows[row] |= (row >> bit & 1) << (5 - bit);
+    }
+  }
+  return rows;
+}();
+
+/**
+ * A view of the memory a tile is decoded into, e.g. a tile within the image or a standalone tile.
+ */
+struct ImageTileView final {
+  std::uint8_t* data{nullptr};  // The first byte of the top left pixel of the tile
+  std::size_t row_stride{0};    // The distance between the first bytes of two consecutive rows in bytes
+  PixelFormat pixel_format{PixelFormat::RGB};
+
+  /**
+   * @param bytes_2d a standalone tile
+   * @return view of the standalone RGB tile
+   */
+  static ImageTileView of(ImageTile::bytes_2d_t& bytes_2d) {
+    return {.data = bytes_2d.front().data(), .row_stride = sizeof(ImageTile::row_bytes_t)};
+  }
+};
+
+/**
+ * Writes the pixels of a tile in the order they are stored, i.e. row by row with interlaced rows,
+ * straight to their deinterlaced position in the destination. Pixels are given as palette indices,
+ * which are written as is or resolved to their color, depending on the pixel format of the destination.
+ */
+class TileWriter final {
+ public:
+  TileWriter(const ImageTileView& view, const palette::Palette& palette)
+      : view_{view},
+        palette_{palette},
+        bytes_per_pixel_{bytesPerPixel(view.pixel_format)},
+        row_byte_count_{ImageTile::WIDTH * bytes_per_pixel_},
+        row_{rowData(0)} {}
+
+  /**
+   * @return whether all pixels of the tile have been written
+   */
+  [[nodiscard]] bool full() const { return stored_row_ == ImageTile::HEIGHT; }
+
+  /**
+   * Write the next pixel. Must not be called once the tile is full.
+   * @param palette_index of the color of the pixel, must be within the palette
+   */
+  void writePixel(const std::uint8_t palette_index) {
+    if (view_.pixel_format == PixelFormat::INDEXED) {
+      row_[x_] = palette_index;
+    } else {
+      const palette::Color& color = palette_.colors[palette_index];
+      row_[x_ + 0] = color.red;
+      row_[x_ + 1] = color.green;
+      row_[x_ + 2] = color.blue;
+    }
+    x_ += bytes_per_pixel_;
+    if (x_ == row_byte_count_) {
+      nextRow();
+    }
+  }
+
+  /**
+   * Write a run of pixels of the same color, clipped at the end of the tile.
+   * @param palette_index of the color of the pixels, must be within the palette
+   * @param pixel_count the amount of pixels
+   */
+  void writeRun(std::uint8_t palette_index, std::int32_t pixel_count);
+
+ private:
+  ImageTileView view_;
+  const palette::Palette& palette_;
+  std::int32_t bytes_per_pixel_;
+  std::int32_t row_byte_count_;
+  std::uint8_t* row_;
+  std::int32_t stored_row_{0};
+  std::int32_t x_{0};  // Byte offset within the row
+
+  [[nodiscard]] std::uint8_t* rowData(const std::int32_t stored_row) const {
+    return view_.data + DEINTERLACED_ROWS[stored_row] * view_.row_stride;
+  }
+
+  void nextRow() {
+    x_ = 0;
+    if (++stored_row_ < ImageTile::HEIGHT) {
+      row_ = rowData(stored_row_);
+    }
+  }
+};
+
+void TileWriter::writeRun(const std::uint8_t palette_index, std::int32_t pixel_count) {
+  const palette::Color& color = palette_.colors[palette_index];
+  while (pixel_count > 0 && !full()) {
+    const std::int32_t row_pixel_count = std::min(pixel_count, (row_byte_count_ - x_) / bytes_per_pixel_);
+    const std::int32_t row_byte_count = row_pixel_count * bytes_per_pixel_;
+    const std::span<std::uint8_t> row_segment{row_ + x_, static_cast<std::size_t>(row_byte_count)};
+    if (view_.pixel_format == PixelFormat::INDEXED) {
+      util::fillIndex(row_segment, palette_index);
+    } else {
+      util::fillRgb(row_segment, color.red, color.green, color.blue);
+    }
+    pixel_count -= row_pixel_count;
+    x_ += row_byte_count;
+    if (x_ == row_byte_count_) {
+      nextRow();
+    }
+  }
+}
+
+}  // namespace qct::image
@@ -1,11 +1,12 @@
 module;
 
 #include <cstdint>
-#include <fstream>
+#include <ostream>
 
 export module qct:meta.datum;
 
 import :common.alias;
+import :util.file_source;
 import :util.reader;
 
 export namespace qct::meta {
@@ -21,7 +22,7 @@ struct DatumShift final {
   double north{0};
   double east{0};
 
-  static DatumShift parse(std::ifstream& file, byte_offset_t pointer_byte_offset);
+  static DatumShift parse(const util::FileSource& file, byte_offset_t pointer_byte_offset);
 
   friend std::ostream& operator<<(std::ostream& os, const DatumShift& datum_shift) {
     os << "North: " << datum_shift.north << ", East: " << datum_shift.east;
@@ -29,7 +30,7 @@ struct DatumShift final {
   }
 };
 
-DatumShift DatumShift::parse(std::ifstream& file, const byte_offset_t pointer_byte_offset) {
+DatumShift DatumShift::parse(const util::FileSource& file, const byte_offset_t pointer_byte_offset) {
   const byte_offset_t byte_offset = util::readInt(file, pointer_byte_offset);
   return {.north = util::readDouble(file, byte_offset + 0x00), .east = util::readDouble(file, byte_offset + 0x08)};
 }
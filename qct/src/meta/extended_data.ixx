@@ -1,13 +1,14 @@
 module;
 
 #include <cstdint>
-#include <fstream>
+#include <ostream>
 #include <string>
 
 export module qct:meta.extended;
 
 import :common.alias;
 import :meta.datum;
+import :util.file_source;
 import :util.reader;
 
 export namespace qct::meta {
@@ -31,7 +32,7 @@ struct ExtendedData final {
   std::string disk_name{};
   std::string associated_data{};
 
-  static ExtendedData parse(std::ifstream& file, byte_offset_t pointer_byte_offset);
+  static ExtendedData parse(const util::FileSource& file, byte_offset_t pointer_byte_offset);
 
   friend std::ostream& operator<<(std::ostream& os, const ExtendedData& extended_data) {
     os << "\n"
@@ -43,7 +44,7 @@ struct ExtendedData final {
   }
 };
 
-ExtendedData ExtendedData::parse(std::ifstream& file, const byte_offset_t pointer_byte_offset) {
+ExtendedData ExtendedData::parse(const util::FileSource& file, const byte_offset_t pointer_byte_offset) {
   const byte_offset_t byte_offset = util::readInt(file, pointer_byte_offset);
   return {.map_type = util::readStringFromPointer(file, byte_offset + 0x00),
           .datum_shift = DatumShift::parse(file, byte_offset + 0x04),
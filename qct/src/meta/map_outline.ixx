@@ -1,12 +1,15 @@
 module;
 
 #include <cstdint>
-#include <fstream>
+#include <format>
+#include <ostream>
 #include <vector>
 
 export module qct:meta.outline;
 
 import :common.alias;
+import :common.exception;
+import :util.file_source;
 import :util.reader;
 
 export namespace qct::meta {
@@ -24,8 +27,6 @@ struct MapOutline final {
     double latitude{0};
     double longitude{0};
 
-    static Point parse(std::ifstream& file, byte_offset_t byteOffset);
-
     friend std::ostream& operator<<(std::ostream& os, const Point& point) {
       os << "Lat: " << point.latitude << ", Lon: " << point.longitude;
       return os;
@@ -33,7 +34,7 @@ struct MapOutline final {
   };
   std::vector<Point> points{};
 
-  static MapOutline parse(std::ifstream& file, byte_offset_t pointCountByteOffset,
+  static MapOutline parse(const util::FileSource& file, byte_offset_t pointCountByteOffset,
                           byte_offset_t arrayPointerByteOffset);
 
   friend std::ostream& operator<<(std::ostream& os, const MapOutline& map_outline) {
@@ -45,17 +46,21 @@ struct MapOutline final {
   }
 };
 
-MapOutline::Point MapOutline::Point::parse(std::ifstream& file, const byte_offset_t byteOffset) {
-  return {util::readDouble(file, byteOffset + 0x00), util::readDouble(file, byteOffset + 0x08)};
-}
-
-MapOutline MapOutline::parse(std::ifstream& file, const byte_offset_t pointCountByteOffset,
+MapOutline MapOutline::parse(const util::FileSource& file, const byte_offset_t pointCountByteOffset,
                              const byte_offset_t arrayPointerByteOffset) {
   const std::int32_t pointCount = util::readInt(file, pointCountByteOffset);
   const byte_offset_t arrayByteOffset = util::readInt(file, arrayPointerByteOffset);
+  // A corrupt count must fail before allocating, so the array size is computed without overflowing
+  const byte_offset_t arrayByteCount = byte_offset_t{pointCount} * 2 * 0x08;
+  if (pointCount < 0 || arrayByteOffset < 0 || file.size() < arrayByteOffset ||
+      file.size() - arrayByteOffset < arrayByteCount) {
+    throw QctException{std::format("Invalid map outline point count={} at offset={}", pointCount, arrayByteOffset)};
+  }
+  // All points in a single read
+  const std::vector<double> doubles = util::readDoubles(file, arrayByteOffset, byte_offset_t{pointCount} * 2);
   std::vector<Point> points(pointCount);
   for (std::int32_t i = 0; i < pointCount; ++i) {
-    points[i] = Point::parse(file, arrayByteOffset + i * (0x08 + 0x08));
+    points[i] = {.latitude = doubles[i * 2 + 0], .longitude = doubles[i * 2 + 1]};
   }
   return {points};
 }
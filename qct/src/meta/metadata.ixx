@@ -2,8 +2,7 @@ module;
 
 #include <chrono>
 #include <cstdint>
-#include <filesystem>
-#include <fstream>
+#include <ostream>
 #include <string>
 
 export module qct:meta;
@@ -13,6 +12,7 @@ import :meta.extended;
 import :meta.magic;
 import :meta.outline;
 import :meta.version;
+import :util.file_source;
 import :util.reader;
 
 export namespace qct::meta {
@@ -84,7 +84,7 @@ struct Metadata final {
   ExtendedData extended_data{};
   MapOutline map_outline{};
 
-  static Metadata parse(const std::filesystem::path& filepath);
+  static Metadata parse(const util::FileSource& file);
 
   friend std::ostream& operator<<(std::ostream& os, const Metadata& metadata) {
     os << "Metadata:" << "\n"
@@ -113,8 +113,7 @@ struct Metadata final {
   }
 };
 
-Metadata Metadata::parse(const std::filesystem::path& filepath) {
-  std::ifstream file{filepath, std::ios::binary};
+Metadata Metadata::parse(const util::FileSource& file) {
   Metadata metadata{};
   metadata.magic_number = static_cast<MagicNumber>(util::readInt(file, BYTE_OFFSET + 0x00));
   metadata.file_format_version = static_cast<FileFormatVersion>(util::readInt(file, BYTE_OFFSET + 0x04));
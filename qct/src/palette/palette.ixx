@@ -2,14 +2,14 @@ module;
 
 #include <array>
 #include <cstdint>
-#include <filesystem>
-#include <fstream>
-#include <vector>
+#include <ostream>
+#include <span>
 
 export module qct:palette;
 
 import :common.alias;
 import :palette.color;
+import :util.file_source;
 import :util.reader;
 
 export namespace qct::palette {
@@ -26,7 +26,7 @@ struct Palette final {
 
   std::array<Color, COLOR_COUNT> colors{};
 
-  static Palette parse(const std::filesystem::path& filepath);
+  static Palette parse(const util::FileSource& file);
 
   friend std::ostream& operator<<(std::ostream& os, const Palette& palette) {
     os << "Palette:" << "\n";
@@ -42,10 +42,9 @@ struct Palette final {
   }
 };
 
-Palette Palette::parse(const std::filesystem::path& filepath) {
-  std::ifstream file{filepath, std::ios::binary};
+Palette Palette::parse(const util::FileSource& file) {
   std::array<Color, COLOR_COUNT> colors{};
-  const std::vector<std::uint8_t> bytes = util::readBytes(file, BYTE_OFFSET, COLOR_COUNT * 4);
+  const std::span<const std::uint8_t> bytes = util::readBytes(file, BYTE_OFFSET, COLOR_COUNT * 4);
   for (std::int32_t i = 0; i < COLOR_COUNT; ++i) {
     const std::uint8_t blue = bytes[i * 4 + 0];
     const std::uint8_t green = bytes[i * 4 + 1];
@@ -12,14 +12,18 @@ export import :georef.coefficients;
 export import :georef.coordinates;
 
 // image
+export import :image.cache;
 export import :image.decode;
 export import :image.decoder;
 export import :image.decode.huffman;
 export import :image.decode.palette;
 export import :image.decode.pp;
 export import :image.decode.rle;
+export import :image.directory;
 export import :image.index;
+export import :image.reader;
 export import :image.tile;
+export import :image.writer;
 
 // metadata
 export import :meta;
@@ -33,6 +37,14 @@ export import :meta.version;
 export import :palette;
 export import :palette.color;
 
+// tiles
+export import :tiles.renderer;
+
 //  util
+export import :util.bounded_queue;
 export import :util.buffer;
+export import :util.file_source;
+export import :util.fill;
+export import :util.memory_budget;
 export import :util.reader;
+export import :util.thread_pool;
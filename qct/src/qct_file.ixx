@@ -1,56 +1,164 @@
 module;
 
-#include <chrono>
+#include <cstdint>
 #include <filesystem>
-#include <future>
 #include <iostream>
+#include <memory>
 #include <utility>
+#include <vector>
 
 export module qct:file;
 
 import :common.exception;
 import :georef;
 import :image.index;
+import :image.reader;
 import :image.tile;
 import :palette;
 import :meta;
 import :meta.magic;
 import :meta.version;
+import :util.file_source;
+import :util.thread_pool;
 
 export namespace qct {
 /**
  * The QCT-file.
  */
 struct QctFile final {
+  /**
+   * The single, immutable view of the file shared by every parser and tile decoder of this QCT-file.
+   */
+  std::shared_ptr<const util::FileSource> file_source{};
   meta::Metadata metadata{};
   georef::Georef georef{};
   palette::Palette palette{};
-  image::ImageIndex image_index{};
+  /**
+   * The image, decoded on first access. Empty if only the header was parsed.
+   */
+  std::shared_ptr<const image::LazyImageIndex> lazy_image_index{};
+  /**
+   * Random access to single tiles, decoded on first access. Empty if only the header was parsed.
+   */
+  std::shared_ptr<const image::TileReader> tile_reader{};
 
   [[nodiscard]] std::int32_t height() const { return metadata.height_tiles * image::ImageTile::HEIGHT; }
   [[nodiscard]] std::int32_t width() const { return metadata.width_tiles * image::ImageTile::WIDTH; }
 
-  static QctFile parse(const std::filesystem::path& filepath, bool force_decode = false);
+  /**
+   * Get the image, decoding all image tiles on the first call.
+   * @return the image index
+   * @throws QctException if only the header was parsed, or the image tiles cannot be decoded
+   */
+  [[nodiscard]] const image::ImageIndex& imageIndex() const;
+
+  /**
+   * Pass the image to the given consumer band by band, top to bottom, decoding it on the fly unless already decoded.
+   * @param band_consumer invoked with every band in order, on the calling thread
+   * @throws QctException if only the header was parsed, or the image tiles cannot be decoded
+   */
+  void forEachImageBand(const image::image_band_consumer_t& band_consumer) const;
+
+  /**
+   * Get a single decoded tile, without decoding the rest of the image.
+   * @param y_tile the y index of the tile
+   * @param x_tile the x index of the tile
+   * @return the decoded tile, in the pixel format of the decode options
+   * @throws QctException if only the header was parsed, the tile is outside the image or cannot be decoded
+   */
+  [[nodiscard]] std::shared_ptr<const image::DecodedTile> tile(std::int32_t y_tile, std::int32_t x_tile) const;
+
+  /**
+   * Get a rectangular window of the image, decoding only the tiles it covers.
+   * @param x the left column of the window
+   * @param y the top row of the window
+   * @param width the width of the window in pixels
+   * @param height the height of the window in pixels
+   * @return the bytes of the window in row-major order, in the pixel format of the decode options
+   * @throws QctException if only the header was parsed, the window is not within the image or cannot be decoded
+   */
+  [[nodiscard]] std::vector<std::uint8_t> window(std::int32_t x, std::int32_t y, std::int32_t width,
+                                                 std::int32_t height) const;
+
+  /**
+   * Parse the QCT-file. The image tiles are decoded once the image, or a part of it, is first requested.
+   * @param filepath the QCT-file
+   * @param thread_pool to decode the image with, must outlive the parsed QCT-file
+   * @param force_decode whether to attempt decoding despite an unknown magic number or file format version
+   * @param decode_options options for decoding the image tiles
+   * @return the parsed QCT-file
+   */
+  static QctFile parse(const std::filesystem::path& filepath, util::ThreadPool& thread_pool, bool force_decode = false,
+                       const image::DecodeOptions& decode_options = {});
+
+  /**
+   * Parse only the header of the QCT-file: metadata, georeferencing and palette. The tile data is never read.
+   * @param filepath the QCT-file
+   * @param force_decode whether to continue despite an unknown magic number or file format version
+   * @return the parsed QCT-file without an image
+   */
+  static QctFile parseHeader(const std::filesystem::path& filepath, bool force_decode = false);
 
   static void checkMagicNumber(meta::MagicNumber magic_number, bool force_decode = false);
   static void checkFileFormatVersion(meta::FileFormatVersion file_format_version, bool force_decode = false);
 };
 
-QctFile QctFile::parse(const std::filesystem::path& filepath, const bool force_decode) {
-  auto metadata_future = std::async(std::launch::async, meta::Metadata::parse, filepath);
-  auto georef_future = std::async(std::launch::async, georef::Georef::parse, filepath);
-  auto palette_future = std::async(std::launch::async, palette::Palette::parse, filepath);
-  meta::Metadata metadata = metadata_future.get();
-  std::cout << metadata << std::endl;
+const image::ImageIndex& QctFile::imageIndex() const {
+  if (lazy_image_index == nullptr) {
+    throw QctException{"Image not available, only the header of the QCT-file was parsed"};
+  }
+  return lazy_image_index->get();
+}
+
+void QctFile::forEachImageBand(const image::image_band_consumer_t& band_consumer) const {
+  if (lazy_image_index == nullptr) {
+    throw QctException{"Image not available, only the header of the QCT-file was parsed"};
+  }
+  lazy_image_index->forEachBand(band_consumer);
+}
+
+std::shared_ptr<const image::DecodedTile> QctFile::tile(const std::int32_t y_tile, const std::int32_t x_tile) const {
+  if (tile_reader == nullptr) {
+    throw QctException{"Image not available, only the header of the QCT-file was parsed"};
+  }
+  return tile_reader->tile(y_tile, x_tile);
+}
+
+std::vector<std::uint8_t> QctFile::window(const std::int32_t x, const std::int32_t y, const std::int32_t width,
+                                          const std::int32_t height) const {
+  if (tile_reader == nullptr) {
+    throw QctException{"Image not available, only the header of the QCT-file was parsed"};
+  }
+  return tile_reader->window(x, y, width, height);
+}
+
+QctFile QctFile::parse(const std::filesystem::path& filepath, util::ThreadPool& thread_pool, const bool force_decode,
+                       const image::DecodeOptions& decode_options) {
+  QctFile qct_file = parseHeader(filepath, force_decode);
+  // Streaming and random access share the tile directory, it is read once
+  const auto tile_directory = std::make_shared<const image::LazyTileDirectory>(qct_file.file_source, qct_file.metadata);
+  qct_file.lazy_image_index = std::make_shared<const image::LazyImageIndex>(
+      qct_file.file_source, tile_directory, qct_file.metadata, qct_file.palette, thread_pool, decode_options);
+  qct_file.tile_reader = std::make_shared<const image::TileReader>(
+      qct_file.file_source, tile_directory, qct_file.metadata, qct_file.palette, decode_options.pixel_format,
+      decode_options.tile_cache_byte_count);
+  return qct_file;
+}
+
+QctFile QctFile::parseHeader(const std::filesystem::path& filepath, const bool force_decode) {
+  auto file_source = std::make_shared<const util::FileSource>(filepath);
+  // Read in the fixed header (metadata, georeferencing, palette) with one sequential I/O. Parsing it from the mapping
+  // takes microseconds, far less than starting a thread per section would.
+  file_source->prefetch(0, image::ImageIndex::BYTE_OFFSET);
+  meta::Metadata metadata = meta::Metadata::parse(*file_source);
   checkMagicNumber(metadata.magic_number, force_decode);
   checkFileFormatVersion(metadata.file_format_version, force_decode);
-  georef::Georef georef = georef_future.get();
-  palette::Palette palette = palette_future.get();
-  auto image_index = image::ImageIndex::parse(filepath, metadata, palette);
-  return {.metadata = std::move(metadata),
+  georef::Georef georef = georef::Georef::parse(*file_source);
+  palette::Palette palette = palette::Palette::parse(*file_source);
+  return {.file_source = std::move(file_source),
+          .metadata = std::move(metadata),
           .georef = std::move(georef),
-          .palette = std::move(palette),
-          .image_index = std::move(image_index)};
+          .palette = std::move(palette)};
 }
 
 void QctFile::checkMagicNumber(const meta::MagicNumber magic_number, const bool force_decode) {
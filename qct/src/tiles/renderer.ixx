@@ -0,0 +1,339 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <memory>
+#include <numbers>
+#include <unordered_map>
+#include <vector>
+
+export module qct:tiles.renderer;
+
+import :common.exception;
+import :file;
+import :georef.coordinates;
+import :image.cache;
+import :image.tile;
+
+export namespace qct::tiles {
+/**
+ * The coordinates of a tile in the XYZ tiling scheme: the world in the Web Mercator projection (EPSG:3857) is split
+ * into 2^z x 2^z tiles at zoom level z, numbered from the top left.
+ */
+struct TileCoordinates final {
+  std::int32_t z{};
+  std::int32_t x{};
+  std::int32_t y{};
+};
+
+/**
+ * A bounding box in WGS-84 coordinates.
+ */
+struct Wgs84Bounds final {
+  double min_longitude{};
+  double min_latitude{};
+  double max_longitude{};
+  double max_latitude{};
+};
+
+/**
+ * The tiles of a zoom level within inclusive bounds.
+ */
+struct TileRange final {
+  std::int32_t z{};
+  std::int32_t min_x{};
+  std::int32_t min_y{};
+  std::int32_t max_x{-1};
+  std::int32_t max_y{-1};
+
+  [[nodiscard]] std::int32_t width() const { return max_x - min_x + 1; }
+  [[nodiscard]] std::int32_t height() const { return max_y - min_y + 1; }
+  [[nodiscard]] std::int32_t count() const { return width() * height(); }
+
+  /**
+   * @param index of a tile in row-major order, within [0, count())
+   * @return the coordinates of the tile
+   */
+  [[nodiscard]] TileCoordinates at(const std::int32_t index) const {
+    return {.z = z, .x = min_x + index % width(), .y = min_y + index / width()};
+  }
+};
+
+/**
+ * Renders XYZ tiles of a QCT-file, decoding only the image tiles a tile covers.
+ */
+class WebMercatorRenderer final {
+ public:
+  static constexpr std::int32_t TILE_SIZE{256};
+  static constexpr std::int32_t CHANNELS{4};
+  static constexpr std::int32_t MAX_ZOOM{24};
+  /**
+   * The latitude bounding the square world of the projection.
+   */
+  static constexpr double MAX_LATITUDE{85.0511287798066};
+
+  /**
+   * @param qct_file the QCT-file to render, the image must be available and the file must outlive the renderer
+   */
+  explicit WebMercatorRenderer(const QctFile& qct_file) : qct_file_{qct_file} {}
+
+  /**
+   * Render a tile by sampling the nearest image pixel of every tile pixel. Meant for zoom levels at or above the native
+   * one, further out the samples skip image pixels and alias, use downsample() for those.
+   * @param tile_coordinates of the tile
+   * @return the RGBA pixels of the tile, transparent outside the image, or empty if the tile does not overlap the image
+   * @throws QctException if the tile coordinates are invalid, or the image tiles cannot be decoded
+   */
+  [[nodiscard]] std::vector<std::uint8_t> render(const TileCoordinates& tile_coordinates) const;
+
+  /**
+   * Render a tile from its four tiles of the next zoom level, by averaging every 2x2 block of their pixels weighted by
+   * their alpha, so that transparent pixels do not darken the border of the image.
+   * @param child_tiles the RGBA pixels of the top left, top right, bottom left and bottom right child, each empty if it
+   * does not overlap the image
+   * @return the RGBA pixels of the tile, or empty if no child overlaps the image
+   */
+  [[nodiscard]] static std::vector<std::uint8_t> downsample(
+      const std::array<std::vector<std::uint8_t>, 4>& child_tiles);
+
+  /**
+   * @return the zoom level at which a tile pixel is about the size of an image pixel, rounded to the finer level
+   */
+  [[nodiscard]] std::int32_t nativeZoom() const;
+
+  /**
+   * @return the bounds of the WGS-84 coordinates along the border of the image
+   */
+  [[nodiscard]] Wgs84Bounds bounds() const;
+
+  /**
+   * Get the tiles that may overlap the image, within the bounds of the image.
+   * @param z the zoom level
+   * @return the tile range, empty if the zoom level is invalid
+   */
+  [[nodiscard]] TileRange tileRange(std::int32_t z) const;
+
+  /**
+   * Convert pixel coordinates of the whole world at a zoom level into WGS-84 coordinates.
+   * @param x the pixel column, 0 at the antimeridian in the west
+   * @param y the pixel row, 0 at the northern edge of the projection
+   * @param z the zoom level
+   * @return WGS-84 coordinates
+   */
+  [[nodiscard]] static georef::Wgs84Coordinates toWgs84Coordinates(double x, double y, std::int32_t z);
+
+ private:
+  // The image coordinates are computed exactly on a grid and interpolated in between. For the smooth georeferencing
+  // polynomials this stays far below a tile pixel of error, but saves evaluating them for all but a few pixels
+  static constexpr std::int32_t GRID_STEP{16};
+  static constexpr std::int32_t GRID_SIZE{TILE_SIZE / GRID_STEP + 1};
+
+  const QctFile& qct_file_;
+
+  [[nodiscard]] georef::Wgs84Coordinates imageToWgs84Coordinates(double x, double y) const;
+};
+
+std::vector<std::uint8_t> WebMercatorRenderer::render(const TileCoordinates& tile_coordinates) const {
+  const auto [z, x_tile, y_tile] = tile_coordinates;
+  if (z < 0 || MAX_ZOOM < z || x_tile < 0 || (1 << z) <= x_tile || y_tile < 0 || (1 << z) <= y_tile) {
+    throw QctException{std::format("Invalid tile z={}, x={}, y={}", z, x_tile, y_tile)};
+  }
+  std::vector<georef::ImageCoordinates> grid(GRID_SIZE * GRID_SIZE);
+  double min_x{std::numeric_limits<double>::max()};
+  double max_x{std::numeric_limits<double>::lowest()};
+  double min_y{std::numeric_limits<double>::max()};
+  double max_y{std::numeric_limits<double>::lowest()};
+  for (std::int32_t grid_y = 0; grid_y < GRID_SIZE; ++grid_y) {
+    for (std::int32_t grid_x = 0; grid_x < GRID_SIZE; ++grid_x) {
+      const georef::ImageCoordinates image_coordinates = qct_file_.georef.toImageCoordinates(
+          toWgs84Coordinates(static_cast<double>(x_tile) * TILE_SIZE + grid_x * GRID_STEP,
+                             static_cast<double>(y_tile) * TILE_SIZE + grid_y * GRID_STEP, z),
+          qct_file_.metadata.extended_data.datum_shift);
+      grid[grid_y * GRID_SIZE + grid_x] = image_coordinates;
+      min_x = std::min(min_x, image_coordinates.x);
+      max_x = std::max(max_x, image_coordinates.x);
+      min_y = std::min(min_y, image_coordinates.y);
+      max_y = std::max(max_y, image_coordinates.y);
+    }
+  }
+  // Interpolated coordinates never leave the bounds of the grid
+  const std::int32_t width = qct_file_.width();
+  const std::int32_t height = qct_file_.height();
+  if (max_x < 0 || width <= min_x || max_y < 0 || height <= min_y) {
+    return {};
+  }
+
+  std::vector<std::uint8_t> rgba_bytes(TILE_SIZE * TILE_SIZE * CHANNELS);
+  // Neighbouring pixels mostly sample the same image tile, which is only looked up once per tile of the output
+  std::unordered_map<std::int32_t, std::shared_ptr<const image::DecodedTile>> decoded_tiles{};
+  std::int32_t last_tile_index{-1};
+  const image::DecodedTile* last_tile{nullptr};
+  bool overlaps{false};
+  for (std::int32_t y = 0; y < TILE_SIZE; ++y) {
+    const double grid_y = (y + 0.5) / GRID_STEP;
+    const std::int32_t cell_y = std::min(static_cast<std::int32_t>(grid_y), GRID_SIZE - 2);
+    const double fraction_y = grid_y - cell_y;
+    for (std::int32_t x = 0; x < TILE_SIZE; ++x) {
+      const double grid_x = (x + 0.5) / GRID_STEP;
+      const std::int32_t cell_x = std::min(static_cast<std::int32_t>(grid_x), GRID_SIZE - 2);
+      const double fraction_x = grid_x - cell_x;
+      const auto interpolate = [&](const auto coordinate) {
+        const georef::ImageCoordinates* cell = &grid[cell_y * GRID_SIZE + cell_x];
+        const double top = cell[0].*coordinate + (cell[1].*coordinate - cell[0].*coordinate) * fraction_x;
+        const double bottom =
+            cell[GRID_SIZE].*coordinate + (cell[GRID_SIZE + 1].*coordinate - cell[GRID_SIZE].*coordinate) * fraction_x;
+        return top + (bottom - top) * fraction_y;
+      };
+      const double image_x = std::floor(interpolate(&georef::ImageCoordinates::x));
+      const double image_y = std::floor(interpolate(&georef::ImageCoordinates::y));
+      if (image_x < 0 || width <= image_x || image_y < 0 || height <= image_y) {
+        continue;
+      }
+      const auto pixel_x = static_cast<std::int32_t>(image_x);
+      const auto pixel_y = static_cast<std::int32_t>(image_y);
+      const std::int32_t tile_index =
+          pixel_y / image::ImageTile::HEIGHT * qct_file_.metadata.width_tiles + pixel_x / image::ImageTile::WIDTH;
+      if (tile_index != last_tile_index) {
+        std::shared_ptr<const image::DecodedTile>& decoded_tile = decoded_tiles[tile_index];
+        if (decoded_tile == nullptr) {
+          decoded_tile = qct_file_.tile(pixel_y / image::ImageTile::HEIGHT, pixel_x / image::ImageTile::WIDTH);
+        }
+        last_tile_index = tile_index;
+        last_tile = decoded_tile.get();
+      }
+      const std::uint8_t* pixel = last_tile->row(pixel_y % image::ImageTile::HEIGHT).data() +
+                                  pixel_x % image::ImageTile::WIDTH * image::bytesPerPixel(last_tile->pixel_format);
+      std::uint8_t* rgba = &rgba_bytes[(y * TILE_SIZE + x) * CHANNELS];
+      if (last_tile->pixel_format == image::PixelFormat::INDEXED) {
+        const auto [red, green, blue] = qct_file_.palette.colors[*pixel];
+        rgba[0] = red;
+        rgba[1] = green;
+        rgba[2] = blue;
+      } else {
+        std::copy_n(pixel, 3, rgba);
+      }
+      rgba[3] = 0xFF;
+      overlaps = true;
+    }
+  }
+  if (!overlaps) {
+    return {};
+  }
+  return rgba_bytes;
+}
+
+std::vector<std::uint8_t> WebMercatorRenderer::downsample(const std::array<std::vector<std::uint8_t>, 4>& child_tiles) {
+  if (std::ranges::all_of(child_tiles, &std::vector<std::uint8_t>::empty)) {
+    return {};
+  }
+  constexpr std::int32_t half_tile_size{TILE_SIZE / 2};
+  std::vector<std::uint8_t> rgba_bytes(TILE_SIZE * TILE_SIZE * CHANNELS);
+  for (std::size_t child_index = 0; child_index < child_tiles.size(); ++child_index) {
+    const std::vector<std::uint8_t>& child_tile = child_tiles[child_index];
+    if (child_tile.empty()) {
+      continue;
+    }
+    const auto offset_x = static_cast<std::int32_t>(child_index % 2) * half_tile_size;
+    const auto offset_y = static_cast<std::int32_t>(child_index / 2) * half_tile_size;
+    for (std::int32_t y = 0; y < half_tile_size; ++y) {
+      for (std::int32_t x = 0; x < half_tile_size; ++x) {
+        const std::uint8_t* top = &child_tile[(2 * y * TILE_SIZE + 2 * x) * CHANNELS];
+        const std::uint8_t* bottom = top + TILE_SIZE * CHANNELS;
+        const std::array<const std::uint8_t*, 4> pixels{top, top + CHANNELS, bottom, bottom + CHANNELS};
+        std::uint32_t alpha{0};
+        for (const std::uint8_t* pixel : pixels) {
+          alpha += pixel[3];
+        }
+        if (alpha == 0) {
+          continue;
+        }
+        std::uint8_t* rgba = &rgba_bytes[((offset_y + y) * TILE_SIZE + offset_x + x) * CHANNELS];
+        for (std::int32_t channel = 0; channel < 3; ++channel) {
+          std::uint32_t weighted_sum{0};
+          for (const std::uint8_t* pixel : pixels) {
+            weighted_sum += pixel[channel] * std::uint32_t{pixel[3]};
+          }
+          rgba[channel] = static_cast<std::uint8_t>((weighted_sum + alpha / 2) / alpha);
+        }
+        rgba[3] = static_cast<std::uint8_t>((alpha + 2) / 4);
+      }
+    }
+  }
+  return rgba_bytes;
+}
+
+std::int32_t WebMercatorRenderer::nativeZoom() const {
+  const double y = qct_file_.height() / 2.0;
+  const double degrees_per_pixel =
+      std::abs(imageToWgs84Coordinates(qct_file_.width(), y).longitude - imageToWgs84Coordinates(0, y).longitude) /
+      qct_file_.width();
+  if (!(degrees_per_pixel > 0)) {
+    return 0;
+  }
+  const double zoom = std::ceil(std::log2(360.0 / (TILE_SIZE * degrees_per_pixel)));
+  return static_cast<std::int32_t>(std::clamp(zoom, 0.0, static_cast<double>(MAX_ZOOM)));
+}
+
+Wgs84Bounds WebMercatorRenderer::bounds() const {
+  Wgs84Bounds bounds{.min_longitude = std::numeric_limits<double>::max(),
+                     .min_latitude = std::numeric_limits<double>::max(),
+                     .max_longitude = std::numeric_limits<double>::lowest(),
+                     .max_latitude = std::numeric_limits<double>::lowest()};
+  const auto extend = [&](const double x, const double y) {
+    const georef::Wgs84Coordinates coordinates = imageToWgs84Coordinates(x, y);
+    bounds.min_longitude = std::min(bounds.min_longitude, coordinates.longitude);
+    bounds.min_latitude = std::min(bounds.min_latitude, coordinates.latitude);
+    bounds.max_longitude = std::max(bounds.max_longitude, coordinates.longitude);
+    bounds.max_latitude = std::max(bounds.max_latitude, coordinates.latitude);
+  };
+  // The georeferencing is not linear, so the whole border is sampled, not only the corners
+  const std::int32_t width = qct_file_.width();
+  const std::int32_t height = qct_file_.height();
+  for (std::int32_t x = 0; x < width; x += image::ImageTile::WIDTH) {
+    extend(x, 0);
+    extend(x, height);
+  }
+  for (std::int32_t y = 0; y < height; y += image::ImageTile::HEIGHT) {
+    extend(0, y);
+    extend(width, y);
+  }
+  extend(width, height);
+  return bounds;
+}
+
+TileRange WebMercatorRenderer::tileRange(const std::int32_t z) const {
+  if (z < 0 || MAX_ZOOM < z) {
+    return {.z = z};
+  }
+  const auto [min_longitude, min_latitude, max_longitude, max_latitude] = bounds();
+  const double tile_count = std::ldexp(1.0, z);
+  const auto to_tile = [tile_count](const double fraction) {
+    return static_cast<std::int32_t>(std::clamp(std::floor(fraction * tile_count), 0.0, tile_count - 1));
+  };
+  const auto to_y_fraction = [](const double latitude) {
+    const double radians = std::clamp(latitude, -MAX_LATITUDE, MAX_LATITUDE) * std::numbers::pi / 180.0;
+    return (1.0 - std::asinh(std::tan(radians)) / std::numbers::pi) / 2.0;
+  };
+  return {.z = z,
+          .min_x = to_tile((min_longitude + 180.0) / 360.0),
+          .min_y = to_tile(to_y_fraction(max_latitude)),
+          .max_x = to_tile((max_longitude + 180.0) / 360.0),
+          .max_y = to_tile(to_y_fraction(min_latitude))};
+}
+
+georef::Wgs84Coordinates WebMercatorRenderer::imageToWgs84Coordinates(const double x, const double y) const {
+  return qct_file_.georef.toWgs84Coordinates({.x = x, .y = y}, qct_file_.metadata.extended_data.datum_shift);
+}
+
+georef::Wgs84Coordinates WebMercatorRenderer::toWgs84Coordinates(const double x, const double y,
+                                                                  const std::int32_t z) {
+  const double world_size = std::ldexp(TILE_SIZE, z);
+  return {.longitude = x / world_size * 360.0 - 180.0,
+          .latitude = std::atan(std::sinh(std::numbers::pi * (1.0 - 2.0 * y / world_size))) * 180.0 / std::numbers::pi};
+}
+
+}  // namespace qct::tiles
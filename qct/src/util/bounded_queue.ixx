@@ -0,0 +1,96 @@
+module;
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+export module qct:util.bounded_queue;
+
+export namespace qct::util {
+/**
+ * A queue handing items from any number of producers to consumers, blocking the producers while it is full.
+ * Once closed, pushing fails and the consumers drain the remaining items. Thread-safe.
+ * @tparam T the item type
+ */
+template <typename T>
+class BoundedQueue final {
+ public:
+  /**
+   * @param capacity the amount of items after which pushing blocks, at least 1
+   */
+  explicit BoundedQueue(const std::size_t capacity) : capacity_{capacity < 1 ? 1 : capacity} {}
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  /**
+   * Push an item, blocking while the queue is full.
+   * @param item to push
+   * @return whether the item was pushed, false if the queue is closed
+   */
+  bool push(T item);
+
+  /**
+   * Pop the oldest item, blocking while the queue is empty and open.
+   * @return the item, or empty once the queue is closed and drained
+   */
+  std::optional<T> pop();
+
+  /**
+   * Close the queue, waking up all blocked producers and consumers.
+   */
+  void close();
+
+ private:
+  const std::size_t capacity_;
+  std::deque<T> items_{};
+  bool closed_{false};
+  std::mutex mutex_{};
+  std::condition_variable not_full_condition_{};
+  std::condition_variable not_empty_condition_{};
+};
+
+template <typename T>
+bool BoundedQueue<T>::push(T item) {
+  {
+    std::unique_lock lock{mutex_};
+    not_full_condition_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+    if (closed_) {
+      return false;
+    }
+    items_.push_back(std::move(item));
+  }
+  not_empty_condition_.notify_one();
+  return true;
+}
+
+template <typename T>
+std::optional<T> BoundedQueue<T>::pop() {
+  std::optional<T> item{};
+  {
+    std::unique_lock lock{mutex_};
+    not_empty_condition_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return std::nullopt;
+    }
+    item = std::move(items_.front());
+    items_.pop_front();
+  }
+  not_full_condition_.notify_one();
+  return item;
+}
+
+template <typename T>
+void BoundedQueue<T>::close() {
+  {
+    std::lock_guard lock{mutex_};
+    closed_ = true;
+  }
+  not_full_condition_.notify_all();
+  not_empty_condition_.notify_all();
+}
+
+}  // namespace qct::util
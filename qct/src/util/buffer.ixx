@@ -1,63 +1,120 @@
 module;
 
 #include <cstdint>
-#include <fstream>
-#include <vector>
+#include <span>
 
 export module qct:util.buffer;
 
-import :common.alias;
 import :common.exception;
-import :util.reader;
 
 export namespace qct::util {
-class DynamicByteBuffer {
+/**
+ * A sequential reader over a view of bytes.
+ */
+class ByteBuffer {
  public:
-  explicit DynamicByteBuffer(std::ifstream& file, byte_offset_t byte_offset, std::int32_t initial_byte_count);
+  explicit ByteBuffer(std::span<const std::uint8_t> bytes) : bytes_{bytes} {}
 
   /**
-   * @return the next byte in the buffer, advances buffer index by one after reading, may read more bytes from the file if necessary
+   * @return the next byte in the buffer, advances buffer index by one after reading
+   * @throws QctException if the buffer has been exhausted
    */
   [[nodiscard]] std::uint8_t nextByte();
 
+  /**
+   * @return view of the bytes not read yet
+   */
+  [[nodiscard]] std::span<const std::uint8_t> remainingBytes() const { return bytes_.subspan(next_byte_offset_); }
+
  private:
-  std::ifstream& file_;
-  byte_offset_t file_byte_offset_;
-  byte_offset_t next_byte_offset_{0};
-  std::int32_t capacity_multiple_;
-  std::vector<std::uint8_t> buffer_{};
+  std::span<const std::uint8_t> bytes_;
+  std::size_t next_byte_offset_{0};
+};
 
-  [[nodiscard]] std::uint8_t getByte(byte_offset_t buffer_index);
+/**
+ * A sequential reader over the bits of a view of bytes, least significant bit of each byte first.
+ * Up to 57 bits are buffered at a time, so that several bits can be peeked at and consumed at once.
+ * Reading past the end yields zero bits and marks the buffer as exhausted, so that hot loops need not check every read.
+ */
+class BitBuffer {
+ public:
+  static constexpr std::int32_t MAX_PEEK_BIT_COUNT{57};
+
+  explicit BitBuffer(std::span<const std::uint8_t> bytes) : bytes_{bytes} {}
+
+  /**
+   * Buffer as many bytes as fit, or until the bytes have been exhausted.
+   */
+  void refill();
 
-  void readBytes(std::ifstream& file);
+  /**
+   * @return the amount of buffered bits
+   */
+  [[nodiscard]] std::int32_t bitCount() const { return bit_count_; }
+
+  /**
+   * Peek at the next bits, zero-padded if fewer bits are buffered.
+   * @param bit_count the amount of bits, at most MAX_PEEK_BIT_COUNT
+   * @return the next bits, the first bit in the least significant bit
+   */
+  [[nodiscard]] std::uint64_t peek(const std::int32_t bit_count) const {
+    return bits_ & ((std::uint64_t{1} << bit_count) - 1);
+  }
+
+  /**
+   * Consume buffered bits, marks the buffer as exhausted if fewer bits are buffered.
+   * @param bit_count the amount of bits
+   */
+  void consume(std::int32_t bit_count);
+
+  /**
+   * @return the next bit, refills the buffer if needed
+   */
+  [[nodiscard]] bool nextBit();
+
+  /**
+   * @return whether more bits have been consumed than there are
+   */
+  [[nodiscard]] bool exhausted() const { return exhausted_; }
+
+ private:
+  std::span<const std::uint8_t> bytes_;
+  std::size_t next_byte_offset_{0};
+  std::uint64_t bits_{0};
+  std::int32_t bit_count_{0};
+  bool exhausted_{false};
 };
 
-DynamicByteBuffer::DynamicByteBuffer(std::ifstream& file, const byte_offset_t byte_offset,
-                                     const std::int32_t initial_byte_count)
-    : file_{file}, file_byte_offset_{byte_offset}, capacity_multiple_{initial_byte_count} {
-  buffer_.reserve(capacity_multiple_);
-  readBytes(file);
+std::uint8_t ByteBuffer::nextByte() {
+  if (next_byte_offset_ < bytes_.size()) {
+    return bytes_[next_byte_offset_++];
+  }
+  throw QctException{"Failed to read from buffer."};
 }
 
-std::uint8_t DynamicByteBuffer::nextByte() {
-  const std::uint8_t next_byte = getByte(next_byte_offset_++);
-  return next_byte;
-}
-std::uint8_t DynamicByteBuffer::getByte(const byte_offset_t buffer_index) {
-  if (buffer_index < buffer_.size()) {
-    return buffer_[buffer_index];
+void BitBuffer::refill() {
+  while (bit_count_ <= MAX_PEEK_BIT_COUNT - 8 && next_byte_offset_ < bytes_.size()) {
+    bits_ |= static_cast<std::uint64_t>(bytes_[next_byte_offset_++]) << bit_count_;
+    bit_count_ += 8;
   }
-  readBytes(file_);
-  if (buffer_index < buffer_.size()) {
-    return buffer_[buffer_index];
+}
+
+void BitBuffer::consume(std::int32_t bit_count) {
+  if (bit_count_ < bit_count) [[unlikely]] {
+    exhausted_ = true;
+    bit_count = bit_count_;
   }
-  throw QctException{"Failed to read from buffer."};
+  bits_ >>= bit_count;
+  bit_count_ -= bit_count;
 }
 
-void DynamicByteBuffer::readBytes(std::ifstream& file) {
-  std::vector<std::uint8_t> bytes = readBytesSafe(file, file_byte_offset_, capacity_multiple_);
-  buffer_.insert(buffer_.end(), bytes.begin(), bytes.end());
-  file_byte_offset_ += static_cast<byte_offset_t>(bytes.size());
+bool BitBuffer::nextBit() {
+  if (bit_count_ == 0) {
+    refill();
+  }
+  const bool bit = peek(1) != 0;
+  consume(1);
+  return bit;
 }
 
 }  // namespace qct::util
@@ -0,0 +1,219 @@
+module;
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <span>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+export module qct:util.file_source;
+
+import :common.alias;
+import :common.exception;
+
+export namespace qct::util {
+/**
+ * A read-only, memory-mapped file. Bytes are handed out as spans pointing directly into the mapping,
+ * so reading requires neither system calls nor copies. Immutable, thus safe to share between threads.
+ */
+class FileSource final {
+ public:
+  explicit FileSource(const std::filesystem::path& filepath);
+  ~FileSource();
+
+  FileSource(const FileSource&) = delete;
+  FileSource& operator=(const FileSource&) = delete;
+  FileSource(FileSource&& other) noexcept;
+  FileSource& operator=(FileSource&& other) noexcept;
+
+  /**
+   * @return the size of the file in bytes
+   */
+  [[nodiscard]] byte_offset_t size() const { return size_; }
+
+  /**
+   * Get a view of multiple bytes from the given byte offset.
+   * @param byte_offset byte offset to read from
+   * @param count the amount of bytes
+   * @return view of the bytes
+   * @throws QctException if the bytes are not within the file
+   */
+  [[nodiscard]] std::span<const std::uint8_t> bytes(byte_offset_t byte_offset, byte_offset_t count) const;
+
+  /**
+   * Get a view of multiple bytes from the given byte offset, until EOF or byte count met.
+   * @param byte_offset byte offset to read from
+   * @param count the amount of bytes (or EOF, whichever is first)
+   * @return view of the bytes
+   * @throws QctException if the byte offset is not within the file
+   */
+  [[nodiscard]] std::span<const std::uint8_t> bytesSafe(byte_offset_t byte_offset, byte_offset_t count) const;
+
+  /**
+   * Hint that the given byte range is about to be read, so that the OS reads it in with one large sequential I/O
+   * instead of faulting it in page by page. Out of range bytes are ignored.
+   * @param byte_offset byte offset of the range
+   * @param count the amount of bytes in the range
+   */
+  void prefetch(byte_offset_t byte_offset, byte_offset_t count) const noexcept;
+
+ private:
+  const std::uint8_t* data_{nullptr};
+  byte_offset_t size_{0};
+#ifdef _WIN32
+  HANDLE mapping_handle_{nullptr};
+#endif
+
+  void unmap() noexcept;
+};
+
+#ifdef _WIN32
+FileSource::FileSource(const std::filesystem::path& filepath) {
+  const HANDLE file_handle = CreateFileW(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                         FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_handle == INVALID_HANDLE_VALUE) {
+    throw QctException{std::format("Failed to open {}", filepath.string())};
+  }
+  LARGE_INTEGER file_size{};
+  if (!GetFileSizeEx(file_handle, &file_size)) {
+    CloseHandle(file_handle);
+    throw QctException{std::format("Failed to determine the size of {}", filepath.string())};
+  }
+  size_ = static_cast<byte_offset_t>(file_size.QuadPart);
+  if (size_ > 0) {
+    mapping_handle_ = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle_ != nullptr) {
+      data_ = static_cast<const std::uint8_t*>(MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+    }
+  }
+  // The mapping keeps the file open on its own
+  CloseHandle(file_handle);
+  if (size_ > 0 && data_ == nullptr) {
+    unmap();
+    throw QctException{std::format("Failed to memory-map {}", filepath.string())};
+  }
+}
+
+void FileSource::prefetch(const byte_offset_t byte_offset, const byte_offset_t count) const noexcept {
+  if (count <= 0 || byte_offset < 0 || size_ <= byte_offset) {
+    return;
+  }
+  const std::span<const std::uint8_t> range = bytesSafe(byte_offset, count);
+  WIN32_MEMORY_RANGE_ENTRY entry{.VirtualAddress = const_cast<std::uint8_t*>(range.data()),
+                                 .NumberOfBytes = range.size()};
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0);
+}
+
+void FileSource::unmap() noexcept {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_handle_ != nullptr) {
+    CloseHandle(mapping_handle_);
+  }
+  data_ = nullptr;
+  mapping_handle_ = nullptr;
+  size_ = 0;
+}
+#else
+FileSource::FileSource(const std::filesystem::path& filepath) {
+  const int file_descriptor = ::open(filepath.c_str(), O_RDONLY);
+  if (file_descriptor < 0) {
+    throw QctException{std::format("Failed to open {}", filepath.string())};
+  }
+  struct stat file_status{};
+  if (::fstat(file_descriptor, &file_status) != 0) {
+    ::close(file_descriptor);
+    throw QctException{std::format("Failed to determine the size of {}", filepath.string())};
+  }
+  size_ = static_cast<byte_offset_t>(file_status.st_size);
+  if (size_ > 0) {
+    void* mapping = ::mmap(nullptr, static_cast<std::size_t>(size_), PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    if (mapping == MAP_FAILED) {
+      ::close(file_descriptor);
+      throw QctException{std::format("Failed to memory-map {}", filepath.string())};
+    }
+    data_ = static_cast<const std::uint8_t*>(mapping);
+  }
+  // The mapping keeps the file open on its own
+  ::close(file_descriptor);
+}
+
+void FileSource::prefetch(const byte_offset_t byte_offset, const byte_offset_t count) const noexcept {
+  if (count <= 0 || byte_offset < 0 || size_ <= byte_offset) {
+    return;
+  }
+  const std::span<const std::uint8_t> range = bytesSafe(byte_offset, count);
+  // madvise requires a page-aligned address
+  const auto page_size = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+  const auto begin = reinterpret_cast<std::uintptr_t>(range.data()) & ~(page_size - 1);
+  const auto end = reinterpret_cast<std::uintptr_t>(range.data() + range.size());
+  ::madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+}
+
+void FileSource::unmap() noexcept {
+  if (data_ != nullptr) {
+    ::munmap(const_cast<std::uint8_t*>(data_), static_cast<std::size_t>(size_));
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+#endif
+
+FileSource::~FileSource() {
+  unmap();
+}
+
+FileSource::FileSource(FileSource&& other) noexcept
+    : data_{std::exchange(other.data_, nullptr)},
+      size_{std::exchange(other.size_, 0)}
+#ifdef _WIN32
+      ,
+      mapping_handle_{std::exchange(other.mapping_handle_, nullptr)}
+#endif
+{
+}
+
+FileSource& FileSource::operator=(FileSource&& other) noexcept {
+  if (this != &other) {
+    unmap();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+    mapping_handle_ = std::exchange(other.mapping_handle_, nullptr);
+#endif
+  }
+  return *this;
+}
+
+std::span<const std::uint8_t> FileSource::bytes(const byte_offset_t byte_offset, const byte_offset_t count) const {
+  if (byte_offset < 0 || count < 0 || size_ - byte_offset < count) {
+    throw QctException{std::format("Failed to read n={} bytes at offset={}", count, byte_offset)};
+  }
+  return {data_ + byte_offset, static_cast<std::size_t>(count)};
+}
+
+std::span<const std::uint8_t> FileSource::bytesSafe(const byte_offset_t byte_offset, const byte_offset_t count) const {
+  if (byte_offset < 0 || size_ < byte_offset || count < 0) {
+    throw QctException{std::format("Failed to seek to offset={}", byte_offset)};
+  }
+  return {data_ + byte_offset, static_cast<std::size_t>(std::min(count, size_ - byte_offset))};
+}
+
+}  // namespace qct::util
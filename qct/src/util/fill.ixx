@@ -0,0 +1,91 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QCT_FILL_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define QCT_FILL_NEON
+#include <arm_neon.h>
+#endif
+
+export module qct:util.fill;
+
+export namespace qct::util {
+/**
+ * Fill contiguous memory with a repeated RGB triplet.
+ * Vectorized with AVX2 (if enabled at compile time), SSE2 or NEON, and a scalar loop for the remainder.
+ * @param destination the memory to fill, trailing bytes not forming a whole triplet are left untouched
+ * @param red the red component
+ * @param green the green component
+ * @param blue the blue component
+ */
+void fillRgb(std::span<std::uint8_t> destination, std::uint8_t red, std::uint8_t green, std::uint8_t blue);
+
+/**
+ * Fill contiguous memory with a repeated palette index.
+ * @param destination the memory to fill
+ * @param index the palette index
+ */
+void fillIndex(std::span<std::uint8_t> destination, std::uint8_t index);
+
+void fillRgb(const std::span<std::uint8_t> destination, const std::uint8_t red, const std::uint8_t green,
+             const std::uint8_t blue) {
+  std::uint8_t* const bytes = destination.data();
+  const std::size_t byte_count = destination.size() - destination.size() % 3;
+  std::size_t i{0};
+#if defined(__AVX2__) || defined(QCT_FILL_SSE2)
+  // The triplet repeats every 48 bytes, i.e. every 3 SSE2 or 6 AVX2 registers
+  alignas(32) std::array<std::uint8_t, 96> pattern{};
+  for (std::size_t j = 0; j < pattern.size(); j += 3) {
+    pattern[j + 0] = red;
+    pattern[j + 1] = green;
+    pattern[j + 2] = blue;
+  }
+#endif
+#if defined(__AVX2__)
+  const __m256i pattern_0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(pattern.data() + 0));
+  const __m256i pattern_1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(pattern.data() + 32));
+  const __m256i pattern_2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(pattern.data() + 64));
+  for (; i + 96 <= byte_count; i += 96) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(bytes + i + 0), pattern_0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(bytes + i + 32), pattern_1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(bytes + i + 64), pattern_2);
+  }
+#endif
+#if defined(QCT_FILL_SSE2)
+  const __m128i pattern_a = _mm_load_si128(reinterpret_cast<const __m128i*>(pattern.data() + 0));
+  const __m128i pattern_b = _mm_load_si128(reinterpret_cast<const __m128i*>(pattern.data() + 16));
+  const __m128i pattern_c = _mm_load_si128(reinterpret_cast<const __m128i*>(pattern.data() + 32));
+  for (; i + 48 <= byte_count; i += 48) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + i + 0), pattern_a);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + i + 16), pattern_b);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + i + 32), pattern_c);
+  }
+#elif defined(QCT_FILL_NEON)
+  // Interleaving stores write 16 triplets at once
+  const uint8x16x3_t rgb{{vdupq_n_u8(red), vdupq_n_u8(green), vdupq_n_u8(blue)}};
+  for (; i + 48 <= byte_count; i += 48) {
+    vst3q_u8(bytes + i, rgb);
+  }
+#endif
+  for (; i < byte_count; i += 3) {
+    bytes[i + 0] = red;
+    bytes[i + 1] = green;
+    bytes[i + 2] = blue;
+  }
+}
+
+void fillIndex(const std::span<std::uint8_t> destination, const std::uint8_t index) {
+  // A single repeated byte, which every standard library lowers to memset
+  std::ranges::fill(destination, index);
+}
+
+}  // namespace qct::util
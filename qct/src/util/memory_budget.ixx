@@ -0,0 +1,115 @@
+module;
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+export module qct:util.memory_budget;
+
+export namespace qct::util {
+/**
+ * A budget of bytes shared between concurrent jobs, each of which reserves its estimated peak memory before starting.
+ * A reservation larger than the whole budget is granted once nothing else is reserved, so it cannot wait forever.
+ */
+class MemoryBudget final {
+ public:
+  /**
+   * Reserved bytes, returned to the budget on destruction.
+   */
+  class Reservation final {
+   public:
+    Reservation() = default;
+    ~Reservation();
+
+    Reservation(const Reservation&) = delete;
+    Reservation& operator=(const Reservation&) = delete;
+    Reservation(Reservation&& other) noexcept;
+    Reservation& operator=(Reservation&& other) noexcept;
+
+    [[nodiscard]] std::size_t byteCount() const { return byte_count_; }
+
+   private:
+    friend MemoryBudget;
+
+    Reservation(MemoryBudget& memory_budget, const std::size_t byte_count)
+        : memory_budget_{&memory_budget}, byte_count_{byte_count} {}
+
+    MemoryBudget* memory_budget_{nullptr};
+    std::size_t byte_count_{0};
+  };
+
+  /**
+   * @param byte_count the amount of bytes in the budget, 0 for unlimited
+   */
+  explicit MemoryBudget(std::size_t byte_count = 0);
+
+  MemoryBudget(const MemoryBudget&) = delete;
+  MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+  /**
+   * Reserve bytes, blocking until they fit into the budget.
+   * @param byte_count the amount of bytes to reserve
+   * @return the reservation, which must not outlive the budget
+   */
+  [[nodiscard]] Reservation reserve(std::size_t byte_count);
+
+  /**
+   * @return the amount of currently reserved bytes
+   */
+  [[nodiscard]] std::size_t reservedByteCount() const;
+
+ private:
+  const std::size_t byte_count_;
+  std::size_t reserved_byte_count_{0};
+  mutable std::mutex mutex_{};
+  std::condition_variable released_condition_{};
+
+  void release(std::size_t byte_count);
+};
+
+MemoryBudget::MemoryBudget(const std::size_t byte_count) : byte_count_{byte_count} {}
+
+MemoryBudget::Reservation MemoryBudget::reserve(const std::size_t byte_count) {
+  std::unique_lock lock{mutex_};
+  released_condition_.wait(lock, [this, byte_count] {
+    return byte_count_ == 0 || reserved_byte_count_ == 0 || reserved_byte_count_ + byte_count <= byte_count_;
+  });
+  reserved_byte_count_ += byte_count;
+  return {*this, byte_count};
+}
+
+std::size_t MemoryBudget::reservedByteCount() const {
+  std::lock_guard lock{mutex_};
+  return reserved_byte_count_;
+}
+
+void MemoryBudget::release(const std::size_t byte_count) {
+  {
+    std::lock_guard lock{mutex_};
+    reserved_byte_count_ -= byte_count;
+  }
+  released_condition_.notify_all();
+}
+
+MemoryBudget::Reservation::~Reservation() {
+  if (memory_budget_ != nullptr) {
+    memory_budget_->release(byte_count_);
+  }
+}
+
+MemoryBudget::Reservation::Reservation(Reservation&& other) noexcept
+    : memory_budget_{std::exchange(other.memory_budget_, nullptr)}, byte_count_{std::exchange(other.byte_count_, 0)} {}
+
+MemoryBudget::Reservation& MemoryBudget::Reservation::operator=(Reservation&& other) noexcept {
+  if (this != &other) {
+    if (memory_budget_ != nullptr) {
+      memory_budget_->release(byte_count_);
+    }
+    memory_budget_ = std::exchange(other.memory_budget_, nullptr);
+    byte_count_ = std::exchange(other.byte_count_, 0);
+  }
+  return *this;
+}
+
+}  // namespace qct::util
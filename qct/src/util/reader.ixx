@@ -1,9 +1,10 @@
 module;
 
-#include <array>
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <format>
-#include <fstream>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -11,6 +12,7 @@ export module qct:util.reader;
 
 import :common.alias;
 import :common.exception;
+import :util.file_source;
 
 export namespace qct::util {
 /**
@@ -19,25 +21,25 @@ export namespace qct::util {
  * @param byte_offset byte offset to read from
  * @return read byte
  */
-std::uint8_t readByte(std::ifstream& file, byte_offset_t byte_offset);
+std::uint8_t readByte(const FileSource& file, byte_offset_t byte_offset);
 
 /**
  * Reads multiple bytes from the given byte offset.
  * @param file to read from
  * @param byte_offset byte offset to read from
  * @param count the amount of bytes to read
- * @return read bytes
+ * @return view of the read bytes
  */
-std::vector<std::uint8_t> readBytes(std::ifstream& file, byte_offset_t byte_offset, std::int32_t count);
+std::span<const std::uint8_t> readBytes(const FileSource& file, byte_offset_t byte_offset, std::int32_t count);
 
 /**
  * Reads multiple bytes from the given byte offset, until EOF or byte count met.
  * @param file to read from
  * @param byte_offset byte offset to read from
  * @param count the amount of bytes to read (or EOF, whichever is first)
- * @return read bytes
+ * @return view of the read bytes
  */
-std::vector<std::uint8_t> readBytesSafe(std::ifstream& file, byte_offset_t byte_offset, std::int32_t count);
+std::span<const std::uint8_t> readBytesSafe(const FileSource& file, byte_offset_t byte_offset, std::int32_t count);
 
 /**
  * Reads an integer stored as little-endian from the given byte offset.
@@ -45,7 +47,7 @@ std::vector<std::uint8_t> readBytesSafe(std::ifstream& file, byte_offset_t byte_
  * @param byte_offset byte offset to read from
  * @return read integer
  */
-std::int32_t readInt(std::ifstream& file, byte_offset_t byte_offset);
+std::int32_t readInt(const FileSource& file, byte_offset_t byte_offset);
 
 /**
  * Reads a double (8 byte IEEE-754) from the given byte offset.
@@ -53,7 +55,7 @@ std::int32_t readInt(std::ifstream& file, byte_offset_t byte_offset);
  * @param byte_offset byte offset to read from
  * @return read double
  */
-double readDouble(std::ifstream& file, byte_offset_t byte_offset);
+double readDouble(const FileSource& file, byte_offset_t byte_offset);
 
 /**
  * Reads multiple doubles (8 byte IEEE-754) from the given byte offset.
@@ -61,8 +63,9 @@ double readDouble(std::ifstream& file, byte_offset_t byte_offset);
  * @param byte_offset byte offset to read from
  * @param count the amount of doubles to read
  * @return read doubles
+ * @throws QctException if the doubles are not within the file
  */
-std::vector<double> readDoubles(std::ifstream& file, byte_offset_t byte_offset, std::int32_t count);
+std::vector<double> readDoubles(const FileSource& file, byte_offset_t byte_offset, byte_offset_t count);
 
 /**
  * Reads a null-terminated string from the given byte offset.
@@ -70,7 +73,7 @@ std::vector<double> readDoubles(std::ifstream& file, byte_offset_t byte_offset,
  * @param byte_offset byte offset to read from
  * @return read string
  */
-std::string readString(std::ifstream& file, byte_offset_t byte_offset);
+std::string readString(const FileSource& file, byte_offset_t byte_offset);
 
 /**
  * Reads a null-terminated string by first reading the string pointer from the given byte offset,
@@ -79,92 +82,55 @@ std::string readString(std::ifstream& file, byte_offset_t byte_offset);
  * @param pointer_byte_offset byte offset of the pointer to read from
  * @return read string
  */
-std::string readStringFromPointer(std::ifstream& file, byte_offset_t pointer_byte_offset);
+std::string readStringFromPointer(const FileSource& file, byte_offset_t pointer_byte_offset);
 
-std::uint8_t readByte(std::ifstream& file, const byte_offset_t byte_offset) {
-  return readBytes(file, byte_offset, 1)[0];
+std::uint8_t readByte(const FileSource& file, const byte_offset_t byte_offset) {
+  return file.bytes(byte_offset, 1)[0];
 }
 
-std::vector<std::uint8_t> readBytes(std::ifstream& file, const byte_offset_t byte_offset, const std::int32_t count) {
-  file.seekg(byte_offset);
-  if (!file.good()) {
-    throw QctException{std::format("Failed to seek to offset={}", byte_offset)};
-  }
-  std::vector<std::uint8_t> bytes(count);
-  file.read(reinterpret_cast<char*>(bytes.data()), count);
-  if (file.gcount() != count) {
-    throw QctException{std::format("Failed to read n={} bytes at offset={}", count, byte_offset)};
-  }
-  return bytes;
+std::span<const std::uint8_t> readBytes(const FileSource& file, const byte_offset_t byte_offset,
+                                        const std::int32_t count) {
+  return file.bytes(byte_offset, count);
 }
 
-std::vector<std::uint8_t> readBytesSafe(std::ifstream& file, const byte_offset_t byte_offset,
-                                        const std::int32_t count) {
-  file.seekg(byte_offset);
-  if (!file.good()) {
-    throw QctException{std::format("Failed to seek to offset={}", byte_offset)};
-  }
-  std::vector<std::uint8_t> bytes(count);
-  file.read(reinterpret_cast<char*>(bytes.data()), count);
-  bytes.resize(file.gcount());
-  return bytes;
+std::span<const std::uint8_t> readBytesSafe(const FileSource& file, const byte_offset_t byte_offset,
+                                            const std::int32_t count) {
+  return file.bytesSafe(byte_offset, count);
 }
 
-std::int32_t readInt(std::ifstream& file, const byte_offset_t byte_offset) {
-  file.seekg(byte_offset);
-  if (!file.good()) {
-    throw QctException{std::format("Failed to seek to offset={}", byte_offset)};
-  }
-  std::array<unsigned char, 4> bytes{};
-  file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
-  if (file.gcount() != bytes.size()) {
-    throw QctException{std::format("Failed to read integer at offset={}", byte_offset)};
-  }
+std::int32_t readInt(const FileSource& file, const byte_offset_t byte_offset) {
+  const std::span<const std::uint8_t> bytes = file.bytes(byte_offset, 4);
   return static_cast<std::int32_t>(bytes[0]) << 0 | static_cast<std::int32_t>(bytes[1]) << 8 |
          static_cast<std::int32_t>(bytes[2]) << 16 | static_cast<std::int32_t>(bytes[3]) << 24;
 }
 
-double readDouble(std::ifstream& file, const byte_offset_t byte_offset) {
-  file.seekg(byte_offset);
-  if (!file.good()) {
-    throw QctException{std::format("Failed to seek to offset={}", byte_offset)};
-  }
+double readDouble(const FileSource& file, const byte_offset_t byte_offset) {
   double value{0};
-  file.read(reinterpret_cast<char*>(&value), 0x08);
-  if (file.gcount() != 0x08) {
-    throw QctException{std::format("Failed to read double at offset={}", byte_offset)};
-  }
+  std::memcpy(&value, file.bytes(byte_offset, 0x08).data(), 0x08);
   return value;
 }
 
-std::vector<double> readDoubles(std::ifstream& file, const byte_offset_t byte_offset, const std::int32_t count) {
-  std::vector<double> doubles(count, 0);
-  for (std::int32_t i = 0; i < count; ++i) {
-    doubles[i] = readDouble(file, byte_offset + i * 0x08);
+std::vector<double> readDoubles(const FileSource& file, const byte_offset_t byte_offset, const byte_offset_t count) {
+  if (count < 0 || file.size() / 0x08 < count) {
+    throw QctException{std::format("Failed to read n={} doubles at offset={}", count, byte_offset)};
   }
+  // Bounds-checked before allocating, a corrupt count must not allocate more than the file holds
+  const std::span<const std::uint8_t> bytes = file.bytes(byte_offset, count * 0x08);
+  std::vector<double> doubles(static_cast<std::size_t>(count), 0);
+  std::memcpy(doubles.data(), bytes.data(), bytes.size());
   return doubles;
 }
 
-std::string readString(std::ifstream& file, const byte_offset_t byte_offset) {
-  file.seekg(byte_offset);
-  if (!file.good()) {
-    throw QctException{std::format("Failed to seek to offset={}", byte_offset)};
-  }
-  std::string result{};
-  unsigned char ch{0};
-  while (file.get(reinterpret_cast<char&>(ch))) {
-    if (ch == '\0') {
-      break;
-    }
-    result.push_back(static_cast<char>(ch));
-  }
-  if (file.eof() && result.back() != '\0') {
+std::string readString(const FileSource& file, const byte_offset_t byte_offset) {
+  const std::span<const std::uint8_t> bytes = file.bytesSafe(byte_offset, file.size());
+  const auto null_it = std::ranges::find(bytes, '\0');
+  if (null_it == bytes.end()) {
     throw QctException{"Reached EOF before NULL."};
   }
-  return result;
+  return {bytes.begin(), null_it};
 }
 
-std::string readStringFromPointer(std::ifstream& file, const byte_offset_t pointer_byte_offset) {
+std::string readStringFromPointer(const FileSource& file, const byte_offset_t pointer_byte_offset) {
   const byte_offset_t byteOffset = readInt(file, pointer_byte_offset);
   return byteOffset != 0 ? readString(file, byteOffset) : "";
 }
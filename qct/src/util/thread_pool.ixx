@@ -0,0 +1,243 @@
+module;
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+export module qct:util.thread_pool;
+
+export namespace qct::util {
+/**
+ * A fixed-size work-stealing thread pool.
+ * Every worker owns a task queue, from which it pops the most recently pushed task.
+ * An idle worker steals the least recently pushed task from the queues of the other workers.
+ */
+class ThreadPool final {
+ public:
+  /**
+   * @param thread_count the amount of worker threads, non-positive for the hardware concurrency
+   */
+  explicit ThreadPool(std::int32_t thread_count = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  [[nodiscard]] std::int32_t threadCount() const { return static_cast<std::int32_t>(workers_.size()); }
+
+  /**
+   * Submit a task to the pool.
+   * @param task to execute
+   * @return future of the result of the task
+   */
+  template <typename F>
+  std::future<std::invoke_result_t<F>> submit(F&& task);
+
+  /**
+   * Invoke the given function for every index in [0, count). The indices are scheduled in contiguous chunks,
+   * a few per worker, in order to balance the load without flooding the queues. Blocks until all indices are done,
+   * executing pending tasks meanwhile when called from a worker of this pool, like wait.
+   * @param count the amount of indices
+   * @param function to invoke with each index
+   * @throws the first exception thrown by the function, after all chunks have finished
+   */
+  template <typename F>
+  void parallelFor(std::int32_t count, F&& function);
+
+  /**
+   * Wait for the given future. When called from a worker of this pool, pending tasks are executed while waiting,
+   * so that tasks waiting for other tasks cannot starve the pool.
+   * @param future to wait for
+   * @return the result of the future
+   */
+  template <typename T>
+  T wait(std::future<T>& future);
+
+ private:
+  static constexpr std::int32_t CHUNKS_PER_THREAD{4};
+
+  using task_t = std::function<void()>;
+
+  struct WorkerQueue final {
+    std::mutex mutex{};
+    std::deque<task_t> tasks{};
+  };
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_{};
+  std::vector<std::thread> workers_{};
+  std::mutex wake_mutex_{};
+  std::condition_variable wake_condition_{};
+  std::atomic<std::int64_t> pending_task_count_{0};
+  std::atomic<std::size_t> next_queue_index_{0};
+  bool stopping_{false};
+
+  static thread_local const ThreadPool* current_pool_;
+  static thread_local std::size_t current_worker_index_;
+
+  [[nodiscard]] bool isWorkerThread() const { return current_pool_ == this; }
+
+  void push(task_t task);
+  bool tryRunPendingTask();
+  std::optional<task_t> tryPop(std::size_t queue_index);
+  std::optional<task_t> trySteal(std::size_t thief_index);
+  void workerLoop(std::size_t worker_index);
+};
+
+thread_local const ThreadPool* ThreadPool::current_pool_{nullptr};
+thread_local std::size_t ThreadPool::current_worker_index_{0};
+
+ThreadPool::ThreadPool(const std::int32_t thread_count) {
+  const std::size_t worker_count =
+      thread_count > 0 ? static_cast<std::size_t>(thread_count) : std::max(1u, std::thread::hardware_concurrency());
+  queues_.reserve(worker_count);
+  for (std::size_t i = 0; i < worker_count; ++i) {
+    queues_.push_back(std::make_unique<WorkerQueue>());
+  }
+  workers_.reserve(worker_count);
+  for (std::size_t i = 0; i < worker_count; ++i) {
+    workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock{wake_mutex_};
+    stopping_ = true;
+  }
+  wake_condition_.notify_all();
+  std::ranges::for_each(workers_, [](std::thread& worker) { worker.join(); });
+}
+
+template <typename F>
+std::future<std::invoke_result_t<F>> ThreadPool::submit(F&& task) {
+  using result_t = std::invoke_result_t<F>;
+  auto packaged_task = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(task));
+  std::future<result_t> future = packaged_task->get_future();
+  push([packaged_task] { (*packaged_task)(); });
+  return future;
+}
+
+template <typename F>
+void ThreadPool::parallelFor(const std::int32_t count, F&& function) {
+  if (count <= 0)
+    return;
+  const std::int32_t chunk_count = std::min(count, threadCount() * CHUNKS_PER_THREAD);
+  const std::int32_t chunk_size = (count + chunk_count - 1) / chunk_count;
+  std::vector<std::future<void>> chunk_futures{};
+  chunk_futures.reserve(chunk_count);
+  for (std::int32_t begin = 0; begin < count; begin += chunk_size) {
+    const std::int32_t end = std::min(count, begin + chunk_size);
+    chunk_futures.push_back(submit([&function, begin, end] {
+      for (std::int32_t index = begin; index < end; ++index) {
+        function(index);
+      }
+    }));
+  }
+  std::ranges::for_each(chunk_futures, [this](std::future<void>& future) {
+    if (!isWorkerThread()) {
+      future.wait();
+      return;
+    }
+    while (future.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+      if (!tryRunPendingTask()) {
+        future.wait_for(std::chrono::milliseconds{1});
+      }
+    }
+  });
+  std::ranges::for_each(chunk_futures, [](std::future<void>& future) { future.get(); });
+}
+
+template <typename T>
+T ThreadPool::wait(std::future<T>& future) {
+  if (!isWorkerThread()) {
+    return future.get();
+  }
+  while (future.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+    if (!tryRunPendingTask()) {
+      future.wait_for(std::chrono::milliseconds{1});
+    }
+  }
+  return future.get();
+}
+
+void ThreadPool::push(task_t task) {
+  const std::size_t queue_index =
+      isWorkerThread() ? current_worker_index_ : next_queue_index_.fetch_add(1) % queues_.size();
+  {
+    std::lock_guard lock{queues_[queue_index]->mutex};
+    queues_[queue_index]->tasks.push_back(std::move(task));
+  }
+  {
+    // Synchronize with a worker about to sleep, so that the notification cannot be lost.
+    std::lock_guard lock{wake_mutex_};
+    ++pending_task_count_;
+  }
+  wake_condition_.notify_one();
+}
+
+bool ThreadPool::tryRunPendingTask() {
+  const std::size_t worker_index = isWorkerThread() ? current_worker_index_ : 0;
+  std::optional<task_t> task = tryPop(worker_index);
+  if (!task.has_value()) {
+    task = trySteal(worker_index);
+  }
+  if (!task.has_value()) {
+    return false;
+  }
+  --pending_task_count_;
+  (*task)();
+  return true;
+}
+
+std::optional<ThreadPool::task_t> ThreadPool::tryPop(const std::size_t queue_index) {
+  WorkerQueue& queue = *queues_[queue_index];
+  std::lock_guard lock{queue.mutex};
+  if (queue.tasks.empty()) {
+    return std::nullopt;
+  }
+  task_t task = std::move(queue.tasks.back());
+  queue.tasks.pop_back();
+  return task;
+}
+
+std::optional<ThreadPool::task_t> ThreadPool::trySteal(const std::size_t thief_index) {
+  for (std::size_t offset = 1; offset < queues_.size(); ++offset) {
+    WorkerQueue& queue = *queues_[(thief_index + offset) % queues_.size()];
+    std::lock_guard lock{queue.mutex};
+    if (!queue.tasks.empty()) {
+      task_t task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      return task;
+    }
+  }
+  return std::nullopt;
+}
+
+void ThreadPool::workerLoop(const std::size_t worker_index) {
+  current_pool_ = this;
+  current_worker_index_ = worker_index;
+  while (true) {
+    if (tryRunPendingTask()) {
+      continue;
+    }
+    std::unique_lock lock{wake_mutex_};
+    wake_condition_.wait(lock, [this] { return stopping_ || pending_task_count_ > 0; });
+    if (stopping_ && pending_task_count_ == 0) {
+      return;
+    }
+  }
+}
+
+}  // namespace qct::util
@@ -35,7 +35,8 @@ TEST_F(GeorefTest, ParseGeorefCoefficients) {
   const std::vector lon{31.0, 32.0, 33.0, 34.0, 35.0, 36.0, 37.0, 38.0, 39.0, 40.0};
   createTestBinaryFile(temporary_file_path, eas, nor, lat, lon);
 
-  const georef::GeorefCoefficients coefficients = georef::GeorefCoefficients::parse(temporary_file_path);
+  const util::FileSource file{temporary_file_path};
+  const georef::GeorefCoefficients coefficients = georef::GeorefCoefficients::parse(file);
 
   EXPECT_DOUBLE_EQ(coefficients.eas, 1.0);
   EXPECT_DOUBLE_EQ(coefficients.eas_y, 2.0);
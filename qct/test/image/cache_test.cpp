@@ -0,0 +1,49 @@
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+import qct;
+
+using namespace qct;
+
+namespace {
+std::shared_ptr<const image::DecodedTile> makeTile(const std::uint8_t value) {
+  return std::make_shared<const image::DecodedTile>(
+      image::DecodedTile{.pixel_format = image::PixelFormat::INDEXED,
+                         .bytes = std::vector<std::uint8_t>(image::ImageTile::PIXEL_COUNT, value)});
+}
+}  // namespace
+
+TEST(TileCacheTest, EvictsLeastRecentlyUsedTile) {
+  image::TileCache tile_cache{2 * image::ImageTile::PIXEL_COUNT};
+  tile_cache.insert(0, makeTile(0));
+  tile_cache.insert(1, makeTile(1));
+  ASSERT_NE(tile_cache.find(0), nullptr);
+
+  tile_cache.insert(2, makeTile(2));
+
+  EXPECT_NE(tile_cache.find(0), nullptr);
+  EXPECT_EQ(tile_cache.find(1), nullptr);
+  EXPECT_NE(tile_cache.find(2), nullptr);
+  EXPECT_EQ(tile_cache.byteCount(), 2 * image::ImageTile::PIXEL_COUNT);
+}
+
+TEST(TileCacheTest, KeepsTileCachedFirst) {
+  image::TileCache tile_cache{4 * image::ImageTile::PIXEL_COUNT};
+  const std::shared_ptr<const image::DecodedTile> first = tile_cache.insert(5, makeTile(1));
+
+  const std::shared_ptr<const image::DecodedTile> second = tile_cache.insert(5, makeTile(2));
+
+  EXPECT_EQ(second, first);
+  EXPECT_EQ(tile_cache.byteCount(), image::ImageTile::PIXEL_COUNT);
+}
+
+TEST(TileCacheTest, ZeroByteBudgetDisablesCaching) {
+  image::TileCache tile_cache{0};
+  const std::shared_ptr<const image::DecodedTile> tile = tile_cache.insert(0, makeTile(3));
+
+  EXPECT_EQ(tile->bytes.front(), 3);
+  EXPECT_EQ(tile_cache.find(0), nullptr);
+}
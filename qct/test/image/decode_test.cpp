@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+import qct;
+
+using namespace qct;
+
+class ImageTileDecoderTest : public testing::Test {
+ protected:
+  palette::Palette palette{};
+
+  void SetUp() override {
+    palette.colors[3] = {.red = 10, .green = 20, .blue = 30};
+    palette.colors[7] = {.red = 40, .green = 50, .blue = 60};
+  }
+
+  void expectPixel(const image::ImageTile::bytes_2d_t& tile, const std::int32_t y, const std::int32_t x,
+                   const std::int32_t palette_index) const {
+    EXPECT_EQ(tile[y][x * 3 + 0], palette.colors[palette_index].red);
+    EXPECT_EQ(tile[y][x * 3 + 1], palette.colors[palette_index].green);
+    EXPECT_EQ(tile[y][x * 3 + 2], palette.colors[palette_index].blue);
+  }
+};
+
+TEST_F(ImageTileDecoderTest, HuffmanSingleColorTile) {
+  const std::vector<std::uint8_t> tile_bytes{0, 7};
+
+  const image::ImageTile::bytes_2d_t tile = image::decode::HuffmanImageTileDecoder{palette}.decodeTile(tile_bytes);
+
+  expectPixel(tile, 0, 0, 7);
+  expectPixel(tile, 63, 63, 7);
+}
+
+TEST_F(ImageTileDecoderTest, HuffmanCodesLongerThanLookupTable) {
+  // A chain of 12 branches, each with a color on the left: color k has code 1^k 0, the last color has code 1^12
+  constexpr std::int32_t branch_count = 12;
+  std::vector<std::uint8_t> tile_bytes{0};
+  for (std::int32_t k = 0; k < branch_count; ++k) {
+    tile_bytes.push_back(255);  // Near branch, right child 2 nodes ahead
+    tile_bytes.push_back(k % 2 == 0 ? 3 : 7);
+  }
+  tile_bytes.push_back(7);
+  // Pixel p has color p % 13, bits are packed least significant bit first
+  std::vector<bool> bits{};
+  for (std::int32_t pixel = 0; pixel < image::ImageTile::PIXEL_COUNT; ++pixel) {
+    const std::int32_t k = pixel % (branch_count + 1);
+    bits.insert(bits.end(), k, true);
+    if (k < branch_count) {
+      bits.push_back(false);
+    }
+  }
+  for (std::size_t i = 0; i < bits.size(); i += 8) {
+    std::uint8_t byte{0};
+    for (std::size_t j = 0; j < 8 && i + j < bits.size(); ++j) {
+      byte |= static_cast<std::uint8_t>(bits[i + j]) << j;
+    }
+    tile_bytes.push_back(byte);
+  }
+
+  const image::ImageTile::bytes_2d_t tile = image::decode::HuffmanImageTileDecoder{palette}.decodeTile(tile_bytes);
+
+  for (std::int32_t pixel = 0; pixel < image::ImageTile::PIXEL_COUNT; ++pixel) {
+    const std::int32_t k = pixel % (branch_count + 1);
+    expectPixel(tile, image::DEINTERLACED_ROWS[pixel / image::ImageTile::WIDTH], pixel % image::ImageTile::WIDTH,
+                k == branch_count || k % 2 == 1 ? 7 : 3);
+  }
+  tile_bytes.pop_back();
+  EXPECT_THROW(static_cast<void>(image::decode::HuffmanImageTileDecoder{palette}.decodeTile(tile_bytes)),
+               QctException);
+}
+
+TEST_F(ImageTileDecoderTest, HuffmanCodeBookCacheSharesEqualCodeBooks) {
+  image::decode::HuffmanCodeBookCache cache{};
+  const std::vector<std::uint8_t> code_book_bytes{255, 3, 7};
+  const std::vector<std::uint8_t> same_code_book_bytes{code_book_bytes};
+  const std::vector<std::uint8_t> other_code_book_bytes{255, 7, 3};
+
+  const auto compiled_code_book = cache.get(code_book_bytes);
+
+  EXPECT_EQ(cache.get(same_code_book_bytes), compiled_code_book);
+  EXPECT_NE(cache.get(other_code_book_bytes), compiled_code_book);
+  EXPECT_EQ(compiled_code_book->code_book.size(), 3);
+  EXPECT_EQ(compiled_code_book->code_book.node(1).palette_index, 3);
+  EXPECT_THROW(static_cast<void>(cache.get(std::vector<std::uint8_t>{129, 3, 7})), QctException);
+}
+
+TEST_F(ImageTileDecoderTest, HuffmanCodeBookCacheStaysWithinByteBudget) {
+  const std::vector<std::uint8_t> code_book_bytes{255, 3, 7};
+  const std::vector<std::uint8_t> other_code_book_bytes{255, 7, 3};
+  image::decode::HuffmanCodeBookCache cache{code_book_bytes.size() + 40};
+
+  const auto compiled_code_book = cache.get(code_book_bytes);
+  const std::size_t byte_count = cache.byteCount();
+
+  EXPECT_EQ(byte_count, code_book_bytes.size() + compiled_code_book->byteCount());
+  EXPECT_EQ(cache.get(code_book_bytes), compiled_code_book);
+  // The budget is spent, the other code book is compiled on every use
+  EXPECT_NE(cache.get(other_code_book_bytes), cache.get(other_code_book_bytes));
+  EXPECT_EQ(cache.byteCount(), byte_count);
+
+  image::decode::HuffmanCodeBookCache disabled_cache{0};
+  EXPECT_NE(disabled_cache.get(code_book_bytes), disabled_cache.get(code_book_bytes));
+  EXPECT_EQ(disabled_cache.byteCount(), 0);
+}
+
+TEST_F(ImageTileDecoderTest, RleTileFromMemory) {
+  // Sub-palette {3, 7}, 1 bit per index: the upper half of the tile is color 3, the lower half color 7
+  std::vector<std::uint8_t> tile_bytes{2, 3, 7};
+  tile_bytes.insert(tile_bytes.end(), 2048 / 127, 127 << 1 | 0);
+  tile_bytes.push_back((2048 % 127) << 1 | 0);
+  tile_bytes.insert(tile_bytes.end(), 2048 / 127, 127 << 1 | 1);
+  tile_bytes.push_back((2048 % 127) << 1 | 1);
+
+  const image::ImageTile::bytes_2d_t tile = image::decode::RLEImageTileDecoder{palette}.decodeTile(tile_bytes);
+
+  // Rows are stored interlaced, the first 32 stored rows are the even rows of the tile
+  expectPixel(tile, 0, 0, 3);
+  expectPixel(tile, 62, 63, 3);
+  expectPixel(tile, 1, 0, 7);
+  expectPixel(tile, 63, 63, 7);
+}
+
+TEST_F(ImageTileDecoderTest, DecodesIntoImage) {
+  // A 3 x 2 tile image, the tile at (1, 2) is decoded in place
+  constexpr std::int32_t image_width_bytes = 3 * image::ImageTile::ROW_BYTE_COUNT;
+  std::vector<std::uint8_t> image_bytes(2 * image::ImageTile::HEIGHT * image_width_bytes, 0);
+  const image::ImageTileView destination{
+      .data = image_bytes.data() + image::ImageTile::HEIGHT * image_width_bytes + 2 * image::ImageTile::ROW_BYTE_COUNT,
+      .row_stride = image_width_bytes};
+
+  image::decode::HuffmanImageTileDecoder{palette}.decodeTile(std::vector<std::uint8_t>{0, 7}, destination);
+
+  EXPECT_EQ(std::ranges::count(image_bytes, palette.colors[7].red), image::ImageTile::PIXEL_COUNT);
+  EXPECT_EQ(image_bytes[image::ImageTile::HEIGHT * image_width_bytes + 2 * image::ImageTile::ROW_BYTE_COUNT],
+            palette.colors[7].red);
+  EXPECT_EQ(image_bytes.back(), palette.colors[7].blue);
+}
+
+TEST_F(ImageTileDecoderTest, DecodesPaletteIndices) {
+  std::vector<std::uint8_t> tile_bytes{2, 3, 7};
+  tile_bytes.insert(tile_bytes.end(), 4096 / 127, 127 << 1 | 1);
+  tile_bytes.push_back((4096 % 127) << 1 | 1);
+  image::ImageTile::bytes_2d_t tile{};
+  const image::ImageTileView destination{.data = tile.front().data(),
+                                         .row_stride = image::ImageTile::WIDTH,
+                                         .pixel_format = image::PixelFormat::INDEXED};
+
+  image::decode::RLEImageTileDecoder{palette}.decodeTile(tile_bytes, destination);
+
+  // The indexed tile takes up the first third of the RGB sized tile
+  EXPECT_EQ(std::ranges::count(tile.front(), 7), image::ImageTile::ROW_BYTE_COUNT);
+  EXPECT_EQ(tile[image::ImageTile::HEIGHT / 3 - 1].back(), 7);
+  EXPECT_EQ(tile[image::ImageTile::HEIGHT / 3 + 1].front(), 0);
+}
+
+TEST_F(ImageTileDecoderTest, PixelPackingOverwritesStalePixels) {
+  palette.colors[0] = {.red = 1, .green = 2, .blue = 3};
+  image::ImageTile::bytes_2d_t tile{};
+  for (image::ImageTile::row_bytes_t& row : tile) {
+    row.fill(99);
+  }
+
+  image::decode::PixelPackingImageTileDecoder{palette}.decodeTile(std::vector<std::uint8_t>{200},
+                                                                  image::ImageTileView::of(tile));
+
+  for (const std::int32_t y : {0, 1, 62, 63}) {
+    expectPixel(tile, y, 0, 0);
+    expectPixel(tile, y, 63, 0);
+  }
+}
+
+TEST_F(ImageTileDecoderTest, MalformedTilesThrow) {
+  const image::decode::RLEImageTileDecoder rle_decoder{palette};
+  const image::decode::HuffmanImageTileDecoder huffman_decoder{palette};
+
+  EXPECT_THROW(static_cast<void>(rle_decoder.decodeTile(std::vector<std::uint8_t>{})), QctException);
+  EXPECT_THROW(static_cast<void>(rle_decoder.decodeTile(std::vector<std::uint8_t>{2, 3})), QctException);
+  EXPECT_THROW(static_cast<void>(rle_decoder.decodeTile(std::vector<std::uint8_t>{2, 3, 7, 0xFF})), QctException);
+  // Sub-palette of 3 colors, indexed with 2 bits, the 4th color does not exist
+  EXPECT_THROW(static_cast<void>(rle_decoder.decodeTile(std::vector<std::uint8_t>{3, 3, 7, 7, 1 << 2 | 3})),
+               QctException);
+  EXPECT_THROW(static_cast<void>(huffman_decoder.decodeTile(std::vector<std::uint8_t>{0, 129, 3})), QctException);
+}
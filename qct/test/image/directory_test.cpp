@@ -0,0 +1,115 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+import qct;
+
+using namespace qct;
+
+class TileDirectoryTest : public testing::Test {
+ protected:
+  std::filesystem::path temporary_file_path{std::filesystem::temp_directory_path() / "tile_directory_test.qct"};
+
+  void TearDown() override {
+    if (std::filesystem::exists(temporary_file_path)) {
+      std::filesystem::remove(temporary_file_path);
+    }
+  }
+
+  /**
+   * Create a 64-byte file, where the first byte of each 8-byte block determines a tile encoding.
+   */
+  void createTestBinaryFile() const {
+    std::vector<std::uint8_t> bytes(64, 0);
+    bytes[16] = 0;    // Huffman
+    bytes[24] = 5;    // RLE
+    bytes[40] = 200;  // Pixel packing
+    bytes[48] = 255;  // Huffman
+    std::ofstream file{temporary_file_path, std::ios::binary};
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+  }
+};
+
+TEST_F(TileDirectoryTest, ExtentsEndAtNextTile) {
+  createTestBinaryFile();
+  const util::FileSource file{temporary_file_path};
+  const std::vector<std::uint32_t> pointers{40, 16, 48, 24};
+
+  const image::TileDirectory directory = image::TileDirectory::build(file, 2, 2, pointers, 16);
+
+  ASSERT_EQ(directory.tileCount(), 4);
+  EXPECT_EQ(directory.extent(0, 0).byte_offset, 40);
+  EXPECT_EQ(directory.extent(0, 0).byte_count, 8);
+  EXPECT_EQ(directory.extent(0, 0).encoding, image::ImageTile::Encoding::PIXEL_PACKING);
+  EXPECT_EQ(directory.extent(0, 1).byte_offset, 16);
+  EXPECT_EQ(directory.extent(0, 1).byte_count, 8);
+  EXPECT_EQ(directory.extent(0, 1).encoding, image::ImageTile::Encoding::HUFFMAN_CODING);
+  EXPECT_EQ(directory.extent(1, 0).byte_offset, 48);
+  EXPECT_EQ(directory.extent(1, 0).byte_count, 16);
+  EXPECT_EQ(directory.extent(1, 0).encoding, image::ImageTile::Encoding::HUFFMAN_CODING);
+  EXPECT_EQ(directory.extent(1, 1).byte_offset, 24);
+  EXPECT_EQ(directory.extent(1, 1).byte_count, 16);
+  EXPECT_EQ(directory.extent(1, 1).encoding, image::ImageTile::Encoding::RUN_LENGTH_ENCODING);
+}
+
+TEST_F(TileDirectoryTest, SharedPointersShareExtent) {
+  createTestBinaryFile();
+  const util::FileSource file{temporary_file_path};
+  const std::vector<std::uint32_t> pointers{24, 16, 24};
+
+  const image::TileDirectory directory = image::TileDirectory::build(file, 3, 1, pointers, 16);
+
+  EXPECT_EQ(directory.extent(0, 0).byte_offset, 24);
+  EXPECT_EQ(directory.extent(0, 0).byte_count, 40);
+  EXPECT_EQ(directory.extent(0, 2).byte_offset, 24);
+  EXPECT_EQ(directory.extent(0, 2).byte_count, 40);
+  EXPECT_EQ(directory.extent(0, 1).byte_count, 8);
+}
+
+TEST_F(TileDirectoryTest, RejectsPointersOutOfRange) {
+  createTestBinaryFile();
+  const util::FileSource file{temporary_file_path};
+
+  EXPECT_THROW(image::TileDirectory::build(file, 2, 1, std::vector<std::uint32_t>{16, 8}, 16), QctException);
+  EXPECT_THROW(image::TileDirectory::build(file, 2, 1, std::vector<std::uint32_t>{16, 64}, 16), QctException);
+  EXPECT_THROW(image::TileDirectory::build(file, 2, 2, std::vector<std::uint32_t>{16, 24}, 16), QctException);
+}
+
+TEST_F(TileDirectoryTest, ReadBatchesCoalesceContiguousTiles) {
+  createTestBinaryFile();
+  const util::FileSource file{temporary_file_path};
+  // Tiles at [16, 24), [24, 40) (twice), [40, 48) and [48, 64), batches limited to 24 bytes
+  const std::vector<std::uint32_t> pointers{48, 24, 16, 24, 40};
+  const image::TileDirectory directory = image::TileDirectory::build(file, 5, 1, pointers, 16);
+
+  const std::vector<image::TileReadBatch> batches = directory.readBatches(24);
+
+  ASSERT_EQ(batches.size(), 2);
+  EXPECT_EQ(batches[0].byte_offset, 16);
+  EXPECT_EQ(batches[0].byte_count, 24);
+  EXPECT_EQ(batches[0].tile_indices.size(), 3);
+  EXPECT_EQ(batches[1].byte_offset, 40);
+  EXPECT_EQ(batches[1].byte_count, 24);
+  EXPECT_EQ(batches[1].tile_indices.size(), 2);
+}
+
+TEST_F(TileDirectoryTest, ReadBatchesOfTileRangeOnlyCoverTheRange) {
+  createTestBinaryFile();
+  const util::FileSource file{temporary_file_path};
+  // Two bands of two tiles, the tiles of the second band at [16, 24) and [40, 48) are not contiguous
+  const std::vector<std::uint32_t> pointers{24, 48, 40, 16};
+  const image::TileDirectory directory = image::TileDirectory::build(file, 2, 2, pointers, 16);
+
+  const std::vector<image::TileReadBatch> batches = directory.readBatches(64, 2, 2);
+
+  ASSERT_EQ(batches.size(), 2);
+  EXPECT_EQ(batches[0].byte_offset, 16);
+  EXPECT_EQ(batches[0].byte_count, 8);
+  EXPECT_EQ(batches[0].tile_indices, std::vector<std::int32_t>{3});
+  EXPECT_EQ(batches[1].byte_offset, 40);
+  EXPECT_EQ(batches[1].byte_count, 8);
+  EXPECT_EQ(batches[1].tile_indices, std::vector<std::int32_t>{2});
+}
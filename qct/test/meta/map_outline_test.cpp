@@ -0,0 +1,78 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+import qct;
+
+using namespace qct;
+
+class MapOutlineTest : public testing::Test {
+ protected:
+  std::filesystem::path temporary_file_path{std::filesystem::temp_directory_path() / "map_outline_test.qct"};
+
+  void TearDown() override {
+    if (std::filesystem::exists(temporary_file_path)) {
+      std::filesystem::remove(temporary_file_path);
+    }
+  }
+
+  /**
+   * Create a file with the point count at 0x00, the array pointer at 0x04 and two points from 0x08.
+   */
+  void createTestBinaryFile(const std::int32_t point_count, const std::int32_t array_byte_offset) const {
+    std::vector<std::uint8_t> bytes(0x28, 0);
+    std::memcpy(bytes.data() + 0x00, &point_count, 4);
+    std::memcpy(bytes.data() + 0x04, &array_byte_offset, 4);
+    const double doubles[4]{50.0, 10.0, 49.8, 10.448};
+    std::memcpy(bytes.data() + 0x08, doubles, sizeof(doubles));
+    std::ofstream file{temporary_file_path, std::ios::binary};
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+  }
+};
+
+TEST_F(MapOutlineTest, ParsePoints) {
+  createTestBinaryFile(2, 0x08);
+  const util::FileSource file{temporary_file_path};
+
+  const meta::MapOutline map_outline = meta::MapOutline::parse(file, 0x00, 0x04);
+
+  ASSERT_EQ(map_outline.points.size(), 2);
+  EXPECT_DOUBLE_EQ(map_outline.points[0].latitude, 50.0);
+  EXPECT_DOUBLE_EQ(map_outline.points[0].longitude, 10.0);
+  EXPECT_DOUBLE_EQ(map_outline.points[1].latitude, 49.8);
+  EXPECT_DOUBLE_EQ(map_outline.points[1].longitude, 10.448);
+}
+
+TEST_F(MapOutlineTest, RejectsPointsBeyondTheFile) {
+  createTestBinaryFile(3, 0x08);
+  EXPECT_THROW(meta::MapOutline::parse(util::FileSource{temporary_file_path}, 0x00, 0x04), QctException);
+}
+
+TEST_F(MapOutlineTest, RejectsCorruptPointCounts) {
+  // Twice the count overflows 32 bits, and the count times 16 bytes must not be allocated
+  createTestBinaryFile(0x7FFFFFFF, 0x08);
+  EXPECT_THROW(meta::MapOutline::parse(util::FileSource{temporary_file_path}, 0x00, 0x04), QctException);
+  createTestBinaryFile(-1, 0x08);
+  EXPECT_THROW(meta::MapOutline::parse(util::FileSource{temporary_file_path}, 0x00, 0x04), QctException);
+}
+
+TEST_F(MapOutlineTest, RejectsArrayPointersOutsideTheFile) {
+  createTestBinaryFile(1, 0x7FFFFFF0);
+  EXPECT_THROW(meta::MapOutline::parse(util::FileSource{temporary_file_path}, 0x00, 0x04), QctException);
+  createTestBinaryFile(1, -8);
+  EXPECT_THROW(meta::MapOutline::parse(util::FileSource{temporary_file_path}, 0x00, 0x04), QctException);
+}
+
+TEST_F(MapOutlineTest, ReadDoublesRejectsCorruptCounts) {
+  createTestBinaryFile(2, 0x08);
+  const util::FileSource file{temporary_file_path};
+
+  EXPECT_EQ(util::readDoubles(file, 0x08, 4).size(), 4);
+  EXPECT_THROW(static_cast<void>(util::readDoubles(file, 0x08, 5)), QctException);
+  EXPECT_THROW(static_cast<void>(util::readDoubles(file, 0x08, -1)), QctException);
+  EXPECT_THROW(static_cast<void>(util::readDoubles(file, 0x08, std::int64_t{1} << 61)), QctException);
+}
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+import qct;
+
+using namespace qct;
+
+TEST(WebMercatorRendererTest, PixelCoordinatesToWgs84) {
+  constexpr double max_latitude{85.0511287798};
+  const auto top_left = tiles::WebMercatorRenderer::toWgs84Coordinates(0, 0, 0);
+  EXPECT_DOUBLE_EQ(top_left.longitude, -180.0);
+  EXPECT_NEAR(top_left.latitude, max_latitude, 1e-9);
+
+  const auto center = tiles::WebMercatorRenderer::toWgs84Coordinates(512, 512, 2);
+  EXPECT_DOUBLE_EQ(center.longitude, 0.0);
+  EXPECT_NEAR(center.latitude, 0.0, 1e-12);
+
+  const auto bottom_right = tiles::WebMercatorRenderer::toWgs84Coordinates(1 << 18, 1 << 18, 10);
+  EXPECT_DOUBLE_EQ(bottom_right.longitude, 180.0);
+  EXPECT_NEAR(bottom_right.latitude, -max_latitude, 1e-9);
+}
+
+TEST(WebMercatorRendererTest, RenderRejectsInvalidTiles) {
+  const QctFile qct_file{};
+  const tiles::WebMercatorRenderer renderer{qct_file};
+  EXPECT_THROW(static_cast<void>(renderer.render({.z = -1, .x = 0, .y = 0})), QctException);
+  EXPECT_THROW(static_cast<void>(renderer.render({.z = 1, .x = 2, .y = 0})), QctException);
+  EXPECT_THROW(static_cast<void>(renderer.render({.z = tiles::WebMercatorRenderer::MAX_ZOOM + 1, .x = 0, .y = 0})),
+               QctException);
+}
+
+TEST(WebMercatorRendererTest, NativeZoomAndTileRangeFollowTheGeoref) {
+  // 448 x 320 pixels covering 10.0 to 10.448 degrees east and 50.0 to 49.8 degrees north
+  QctFile qct_file{};
+  qct_file.metadata.width_tiles = 7;
+  qct_file.metadata.height_tiles = 5;
+  qct_file.georef.coefficients.lon = 10.0;
+  qct_file.georef.coefficients.lon_x = 0.001;
+  qct_file.georef.coefficients.lat = 50.0;
+  qct_file.georef.coefficients.lat_y = -1.0 / 1600;
+  const tiles::WebMercatorRenderer renderer{qct_file};
+
+  EXPECT_EQ(renderer.nativeZoom(), 11);
+  const tiles::TileRange tile_range = renderer.tileRange(12);
+  EXPECT_EQ(tile_range.min_x, 2161);
+  EXPECT_EQ(tile_range.max_x, 2166);
+  EXPECT_EQ(tile_range.min_y, 1389);
+  EXPECT_EQ(tile_range.max_y, 1392);
+  EXPECT_EQ(tile_range.count(), 24);
+  EXPECT_EQ(tile_range.at(7).x, 2162);
+  EXPECT_EQ(tile_range.at(7).y, 1390);
+}
+
+TEST(WebMercatorRendererTest, DownsampleAveragesOpaquePixels) {
+  constexpr std::int32_t tile_size{tiles::WebMercatorRenderer::TILE_SIZE};
+  constexpr std::int32_t channels{tiles::WebMercatorRenderer::CHANNELS};
+  EXPECT_TRUE(tiles::WebMercatorRenderer::downsample({}).empty());
+
+  // Only the bottom right child overlaps the image, its top left 2x2 pixels are half transparent
+  std::array<std::vector<std::uint8_t>, 4> child_tiles{};
+  child_tiles[3].resize(tile_size * tile_size * channels);
+  const auto set_pixel = [&](const std::int32_t x, const std::int32_t y, const std::array<std::uint8_t, 4>& rgba) {
+    std::ranges::copy(rgba, child_tiles[3].begin() + (y * tile_size + x) * channels);
+  };
+  set_pixel(0, 0, {100, 0, 10, 0xFF});
+  set_pixel(1, 0, {200, 0, 20, 0xFF});
+  set_pixel(1, 1, {0, 0xFF, 0xFF, 0});
+  const std::vector<std::uint8_t> rgba_bytes = tiles::WebMercatorRenderer::downsample(child_tiles);
+  ASSERT_EQ(rgba_bytes.size(), tile_size * tile_size * channels);
+
+  const std::uint8_t* pixel = &rgba_bytes[(tile_size / 2 * tile_size + tile_size / 2) * channels];
+  // The transparent pixels do not contribute to the color
+  EXPECT_EQ(pixel[0], 150);
+  EXPECT_EQ(pixel[1], 0);
+  EXPECT_EQ(pixel[2], 15);
+  EXPECT_EQ(pixel[3], 128);
+  EXPECT_EQ(rgba_bytes[3], 0);
+  EXPECT_EQ(rgba_bytes[((tile_size - 1) * tile_size + tile_size - 1) * channels + 3], 0);
+}
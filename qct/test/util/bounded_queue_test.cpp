@@ -0,0 +1,39 @@
+#include <chrono>
+#include <future>
+#include <optional>
+
+#include <gtest/gtest.h>
+
+import qct;
+
+using namespace qct;
+
+TEST(BoundedQueueTest, PopsInPushOrderAndDrainsAfterClose) {
+  util::BoundedQueue<int> queue{4};
+  EXPECT_TRUE(queue.push(1));
+  EXPECT_TRUE(queue.push(2));
+  queue.close();
+  EXPECT_FALSE(queue.push(3));
+  EXPECT_EQ(queue.pop(), std::optional{1});
+  EXPECT_EQ(queue.pop(), std::optional{2});
+  EXPECT_EQ(queue.pop(), std::nullopt);
+}
+
+TEST(BoundedQueueTest, PushBlocksWhileFull) {
+  util::BoundedQueue<int> queue{1};
+  EXPECT_TRUE(queue.push(1));
+  std::future<bool> second = std::async(std::launch::async, [&queue] { return queue.push(2); });
+  EXPECT_EQ(second.wait_for(std::chrono::milliseconds{50}), std::future_status::timeout);
+  EXPECT_EQ(queue.pop(), std::optional{1});
+  EXPECT_TRUE(second.get());
+  EXPECT_EQ(queue.pop(), std::optional{2});
+}
+
+TEST(BoundedQueueTest, CloseWakesBlockedProducers) {
+  util::BoundedQueue<int> queue{1};
+  EXPECT_TRUE(queue.push(1));
+  std::future<bool> second = std::async(std::launch::async, [&queue] { return queue.push(2); });
+  EXPECT_EQ(second.wait_for(std::chrono::milliseconds{50}), std::future_status::timeout);
+  queue.close();
+  EXPECT_FALSE(second.get());
+}
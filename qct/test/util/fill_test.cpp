@@ -0,0 +1,41 @@
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+import qct;
+
+using namespace qct;
+
+TEST(FillTest, FillRgbRepeatsTriplet) {
+  // Cover the vectorized loops, the scalar remainder and unaligned starts
+  for (std::size_t offset = 0; offset < 4; ++offset) {
+    for (std::size_t pixel_count = 0; pixel_count < 80; ++pixel_count) {
+      std::vector<std::uint8_t> bytes(offset + pixel_count * 3 + 2, 0xEE);
+
+      util::fillRgb(std::span{bytes}.subspan(offset, pixel_count * 3 + 2), 1, 2, 3);
+
+      for (std::size_t i = 0; i < offset; ++i) {
+        ASSERT_EQ(bytes[i], 0xEE);
+      }
+      for (std::size_t i = 0; i < pixel_count * 3; ++i) {
+        ASSERT_EQ(bytes[offset + i], i % 3 + 1) << "offset=" << offset << ", pixel_count=" << pixel_count;
+      }
+      // Trailing bytes not forming a whole triplet
+      ASSERT_EQ(bytes[offset + pixel_count * 3 + 0], 0xEE);
+      ASSERT_EQ(bytes[offset + pixel_count * 3 + 1], 0xEE);
+    }
+  }
+}
+
+TEST(FillTest, FillIndex) {
+  std::vector<std::uint8_t> bytes(100, 0);
+
+  util::fillIndex(std::span{bytes}.subspan(10, 80), 42);
+
+  EXPECT_EQ(bytes[9], 0);
+  EXPECT_EQ(bytes[10], 42);
+  EXPECT_EQ(bytes[89], 42);
+  EXPECT_EQ(bytes[90], 0);
+}
@@ -0,0 +1,39 @@
+#include <chrono>
+#include <future>
+#include <optional>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+import qct;
+
+using namespace qct;
+
+TEST(MemoryBudgetTest, ReservationsAreReturnedOnDestruction) {
+  util::MemoryBudget memory_budget{100};
+  {
+    const util::MemoryBudget::Reservation first = memory_budget.reserve(60);
+    util::MemoryBudget::Reservation second = memory_budget.reserve(40);
+    EXPECT_EQ(memory_budget.reservedByteCount(), 100);
+    const util::MemoryBudget::Reservation moved = std::move(second);
+    EXPECT_EQ(memory_budget.reservedByteCount(), 100);
+  }
+  EXPECT_EQ(memory_budget.reservedByteCount(), 0);
+}
+
+TEST(MemoryBudgetTest, ReserveBlocksUntilBytesFit) {
+  util::MemoryBudget memory_budget{100};
+  auto first = std::make_optional(memory_budget.reserve(80));
+  std::future<void> second = std::async(std::launch::async, [&memory_budget] {
+    const util::MemoryBudget::Reservation reservation = memory_budget.reserve(50);
+  });
+  EXPECT_EQ(second.wait_for(std::chrono::milliseconds{50}), std::future_status::timeout);
+  first.reset();
+  EXPECT_EQ(second.wait_for(std::chrono::seconds{5}), std::future_status::ready);
+}
+
+TEST(MemoryBudgetTest, OversizedReservationIsGrantedWhenNothingIsReserved) {
+  util::MemoryBudget memory_budget{100};
+  const util::MemoryBudget::Reservation reservation = memory_budget.reserve(1000);
+  EXPECT_EQ(reservation.byteCount(), 1000);
+}
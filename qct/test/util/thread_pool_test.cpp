@@ -0,0 +1,51 @@
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+import qct;
+
+using namespace qct;
+
+TEST(ThreadPoolTest, SubmitReturnsResult) {
+  util::ThreadPool thread_pool{2};
+  std::future<std::int32_t> future = thread_pool.submit([] { return 42; });
+  EXPECT_EQ(thread_pool.wait(future), 42);
+}
+
+TEST(ThreadPoolTest, DefaultThreadCountIsPositive) {
+  const util::ThreadPool thread_pool{};
+  EXPECT_GT(thread_pool.threadCount(), 0);
+}
+
+TEST(ThreadPoolTest, ParallelForVisitsEveryIndexOnce) {
+  util::ThreadPool thread_pool{4};
+  constexpr std::int32_t count = 10007;
+  std::vector<std::atomic<std::int32_t>> visits(count);
+  thread_pool.parallelFor(count, [&visits](const std::int32_t index) { ++visits[index]; });
+  for (std::int32_t i = 0; i < count; ++i) {
+    EXPECT_EQ(visits[i], 1) << "index=" << i;
+  }
+}
+
+TEST(ThreadPoolTest, ParallelForRethrowsException) {
+  util::ThreadPool thread_pool{3};
+  EXPECT_THROW(thread_pool.parallelFor(100,
+                                       [](const std::int32_t index) {
+                                         if (index == 57)
+                                           throw std::runtime_error{"failure"};
+                                       }),
+               std::runtime_error);
+}
+
+TEST(ThreadPoolTest, NestedParallelForDoesNotDeadlock) {
+  util::ThreadPool thread_pool{2};
+  std::atomic<std::int32_t> sum{0};
+  thread_pool.parallelFor(8, [&](const std::int32_t) {
+    thread_pool.parallelFor(8, [&](const std::int32_t index) { sum += index; });
+  });
+  EXPECT_EQ(sum, 8 * 28);
+}